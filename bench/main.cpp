@@ -0,0 +1,494 @@
+#include <chrono>
+#include <rectray.h>
+#include <stdio.h>
+#include <thread>
+
+// DirectXMath subset used by rectray.
+// run the same binary built with and without simd to compare.
+
+// ops: elements processed per iteration of f
+template <typename F>
+void Bench(const char *name, int count, size_t ops, const F &f) {
+  // warm up
+  f(count / 10);
+  auto start = std::chrono::steady_clock::now();
+  f(count);
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+  printf("%-24s %8.2f ns/op\n", name, ns / count / ops);
+}
+
+template <typename F> void Bench(const char *name, int count, const F &f) {
+  Bench(name, count, 1, f);
+}
+
+// keep results alive
+static volatile float g_sink;
+
+int main(int, char **) {
+#if defined(_XM_NO_INTRINSICS_)
+  printf("[DirectXMath: no intrinsics]\n");
+#elif defined(_XM_SSE_INTRINSICS_)
+#ifdef __EMSCRIPTEN__
+  printf("[DirectXMath: sse -> wasm simd128]\n");
+#else
+  printf("[DirectXMath: sse]\n");
+#endif
+#else
+  printf("[DirectXMath: other]\n");
+#endif
+
+  const int COUNT = 1000000;
+
+  std::vector<DirectX::XMFLOAT3> points(1024);
+  for (size_t i = 0; i < points.size(); ++i) {
+    points[i] = {(float)i, (float)(i * 2), (float)(i * 3)};
+  }
+  auto m = DirectX::XMMatrixRotationQuaternion(
+               DirectX::XMQuaternionRotationAxis(
+                   DirectX::XMVectorSet(0, 1, 0, 0), 0.3f)) *
+           DirectX::XMMatrixTranslation(1, 2, 3);
+
+  Bench("load/store", COUNT, [&](int n) {
+    DirectX::XMFLOAT3 acc{};
+    for (int i = 0; i < n; ++i) {
+      auto v = DirectX::XMLoadFloat3(&points[i & 1023]);
+      DirectX::XMStoreFloat3(
+          &acc, DirectX::XMVectorAdd(v, DirectX::XMLoadFloat3(&acc)));
+    }
+    g_sink = acc.x;
+  });
+
+  Bench("Vector3Transform", COUNT, [&](int n) {
+    DirectX::XMFLOAT4 p;
+    for (int i = 0; i < n; ++i) {
+      DirectX::XMStoreFloat4(
+          &p, DirectX::XMVector3Transform(
+                  DirectX::XMLoadFloat3(&points[i & 1023]), m));
+    }
+    g_sink = p.x;
+  });
+
+  Bench("QuaternionMultiply", COUNT, [&](int n) {
+    auto q = DirectX::XMQuaternionRotationAxis(
+        DirectX::XMVectorSet(1, 0, 0, 0), 0.001f);
+    auto r = DirectX::XMQuaternionIdentity();
+    for (int i = 0; i < n; ++i) {
+      r = DirectX::XMQuaternionMultiply(r, q);
+    }
+    g_sink = DirectX::XMVectorGetX(r);
+  });
+
+  Bench("Vector3Rotate", COUNT, [&](int n) {
+    auto q = DirectX::XMQuaternionRotationAxis(
+        DirectX::XMVectorSet(1, 0, 0, 0), 0.5f);
+    DirectX::XMFLOAT3 p;
+    for (int i = 0; i < n; ++i) {
+      DirectX::XMStoreFloat3(
+          &p,
+          DirectX::XMVector3Rotate(DirectX::XMLoadFloat3(&points[i & 1023]), q));
+    }
+    g_sink = p.x;
+  });
+
+  Bench("MatrixMultiply", COUNT, [&](int n) {
+    auto r = DirectX::XMMatrixIdentity();
+    for (int i = 0; i < n; ++i) {
+      r = DirectX::XMMatrixMultiply(r, m);
+    }
+    g_sink = DirectX::XMVectorGetX(r.r[0]);
+  });
+
+  Bench("MatrixInverse", COUNT, [&](int n) {
+    auto r = m;
+    for (int i = 0; i < n; ++i) {
+      r = DirectX::XMMatrixInverse(nullptr, r);
+    }
+    g_sink = DirectX::XMVectorGetX(r.r[0]);
+  });
+
+  Bench("Intersects(Ray, Cube)", COUNT / 10, [&](int n) {
+    rectray::Ray ray{{0, 0, 10}, {0, 0, -1}};
+    int hit = 0;
+    for (int i = 0; i < n; ++i) {
+      if (rectray::Intersects(ray, m)) {
+        ++hit;
+      }
+    }
+    g_sink = (float)hit;
+  });
+
+  Bench("ToMarker(Cube)", COUNT / 100, [&](int n) {
+    rectray::Camera camera;
+    camera.Transform.Translation = {0, 0, 10};
+    camera.Update();
+    rectray::ViewportState viewport{
+        .ViewportWidth = 640,
+        .ViewportHeight = 480,
+    };
+    rectray::DrawList drawlist;
+    for (int i = 0; i < n; ++i) {
+      rectray::gizmo::Cube cube;
+      DirectX::XMStoreFloat4x4(&cube.Matrix, m);
+      drawlist.Gizmos.push_back({cube});
+      drawlist.ToMarker(camera, viewport);
+      drawlist.Clear();
+    }
+  });
+
+  // per object cost of a frame: submit, cull and pick
+  {
+    const int OBJECTS = 10000;
+    std::vector<DirectX::XMFLOAT4X4> matrices(OBJECTS);
+    std::vector<rectray::Handle> handles(OBJECTS);
+    rectray::HandlePool<int> pool;
+    for (int i = 0; i < OBJECTS; ++i) {
+      DirectX::XMStoreFloat4x4(
+          &matrices[i], DirectX::XMMatrixTranslation((float)(i % 100) - 50,
+                                                     (float)(i / 100) - 50,
+                                                     -(float)(i % 7) * 3));
+      handles[i] = pool.Create(i);
+    }
+    rectray::Camera camera;
+    camera.Transform.Translation = {0, 0, 40};
+    camera.Update();
+    rectray::ViewportState viewport{
+        .Focus = rectray::ViewportFocus::Hover,
+        .ViewportWidth = 640,
+        .ViewportHeight = 480,
+        .MouseX = 320,
+        .MouseY = 240,
+    };
+    rectray::Gui gui;
+
+    Bench("Gui::Cube", COUNT / OBJECTS, OBJECTS, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        gui.Begin(camera, viewport);
+        for (int j = 0; j < OBJECTS; ++j) {
+          gui.Cube(handles[j], DirectX::XMLoadFloat4x4(&matrices[j]));
+        }
+        g_sink = gui.End().Closest ? 1.0f : 0.0f;
+      }
+    });
+    Bench("Gui::Cubes", COUNT / OBJECTS, OBJECTS, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        gui.Begin(camera, viewport);
+        gui.Cubes(matrices, handles);
+        g_sink = gui.End().Closest ? 1.0f : 0.0f;
+      }
+    });
+    gui.SetOcclusion(true);
+    Bench("Gui::Cubes occlusion", COUNT / OBJECTS, OBJECTS, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        gui.Begin(camera, viewport);
+        gui.Cubes(matrices, handles);
+        g_sink = gui.End().Closest ? 1.0f : 0.0f;
+      }
+    });
+    gui.SetOcclusion(false);
+  }
+
+  // a frame of object name labels
+  {
+    const int LABELS = 1000;
+    std::vector<std::string> labels(LABELS);
+    for (int i = 0; i < LABELS; ++i) {
+      labels[i] = "object #" + std::to_string(i);
+    }
+    rectray::DrawList drawlist;
+    auto Labels = [&](rectray::TextStorage storage) {
+      return [&, storage](int n) {
+        for (int i = 0; i < n; ++i) {
+          drawlist.Clear();
+          for (auto &label : labels) {
+            drawlist.AddText({}, 0xFFFFFFFF, label, storage);
+          }
+        }
+      };
+    };
+    Bench("DrawList::AddText", COUNT / LABELS, LABELS,
+          Labels(rectray::TextStorage::Frame));
+    Bench("DrawList::AddText interned", COUNT / LABELS, LABELS,
+          Labels(rectray::TextStorage::Interned));
+  }
+
+  // 10k labels on a 720p viewport, most of them dropped
+  {
+    const int LABELS = 10000;
+    rectray::LabelLayout layout;
+    for (int i = 0; i < LABELS; ++i) {
+      layout.Add({
+          .Anchor = {(float)(i * 7919 % 1280), (float)(i * 104729 % 720)},
+          .Size = {56, 13},
+          .Priority = (float)(i % 3),
+      });
+    }
+    Bench("LabelLayout(10k)", 100, LABELS, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        g_sink = (float)layout.Layout(1280, 720).size();
+      }
+    });
+  }
+
+  // 100k outlined cubes, circles and thick lines to triangles
+  {
+    const int MARKERS = 100000;
+    rectray::DrawList drawlist;
+    for (int i = 0; i < MARKERS / 3; ++i) {
+      DirectX::XMFLOAT2 p{(float)(i % 640), (float)(i / 640 % 480)};
+      DirectX::XMFLOAT2 face[] = {
+          p, {p.x + 8, p.y}, {p.x + 8, p.y + 8}, {p.x, p.y + 8}, p};
+      drawlist.AddPolyline(face, 5, 0xFFFFFFFF, 0, 1);
+      drawlist.AddCircle(p, 6, 0xFF0088FF, 0, 2);
+      drawlist.AddLine(p, {p.x + 20, p.y + 10}, 0xFF00FF00, 2);
+    }
+    rectray::marker::Tessellator tessellator;
+    std::vector<uint32_t> threadCounts{1};
+    if (std::thread::hardware_concurrency() > 1) {
+      threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+    for (auto threads : threadCounts) {
+      rectray::WorkerPool workers(threads);
+      char name[32];
+      snprintf(name, sizeof(name), "Tessellator(100k) x%u", threads);
+      Bench(name, 20, drawlist.Markers.size(), [&](int n) {
+        for (int i = 0; i < n; ++i) {
+          tessellator.Build(drawlist.Markers, &workers);
+        }
+        g_sink = (float)tessellator.Indices().size();
+      });
+    }
+  }
+
+  // surface query against 100k cubes
+  {
+    const int OBJECTS = 100000;
+    std::vector<DirectX::XMFLOAT4X4> matrices(OBJECTS);
+    std::vector<rectray::Aabb> boxes(OBJECTS);
+    for (int i = 0; i < OBJECTS; ++i) {
+      DirectX::XMStoreFloat4x4(
+          &matrices[i], DirectX::XMMatrixTranslation((float)(i % 100) * 2,
+                                                     (float)(i / 100 % 100) * 2,
+                                                     (float)(i / 10000) * 2));
+      boxes[i] = rectray::CubeBounds(matrices[i]);
+    }
+    rectray::Bvh bvh;
+    Bench("Bvh(100k)", 10, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        bvh = rectray::Bvh(boxes);
+      }
+    });
+    Bench("Bvh::Raycast(100k)", COUNT / 100, [&](int n) {
+      int hit = 0;
+      for (int i = 0; i < n; ++i) {
+        rectray::Ray ray{{(float)(i % 200), (float)(i % 190), -10},
+                         {0, 0, 1}};
+        if (bvh.Raycast(ray, [&](uint32_t index, const rectray::Ray &ray) {
+              return rectray::IntersectsCube(ray, matrices[index], nullptr);
+            })) {
+          ++hit;
+        }
+      }
+      g_sink = (float)hit;
+    });
+  }
+
+  // 5M point handles: project, cull, emit and pick
+  {
+    const size_t POINTS = 5000000;
+    std::vector<DirectX::XMFLOAT3> positions(POINTS);
+    for (size_t i = 0; i < POINTS; ++i) {
+      positions[i] = {(float)(i % 2000) * 0.01f - 10,
+                      (float)(i / 2000 % 2500) * 0.008f - 10,
+                      (float)(i % 13) * 0.1f};
+    }
+    rectray::Camera camera;
+    camera.Transform.Translation = {0, 0, 20};
+    camera.Update();
+    rectray::ViewportState viewport{
+        .Focus = rectray::ViewportFocus::Hover,
+        .ViewportWidth = 1280,
+        .ViewportHeight = 720,
+        .MouseX = 640,
+        .MouseY = 360,
+    };
+    rectray::Gui gui;
+    std::vector<uint32_t> threadCounts{1};
+    if (std::thread::hardware_concurrency() > 1) {
+      threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+    for (auto threads : threadCounts) {
+      gui.SetWorkerThreads(threads);
+      char name[32];
+      snprintf(name, sizeof(name), "Gui::Points(5M) x%u", threads);
+      Bench(name, 10, POINTS, [&](int n) {
+        for (int i = 0; i < n; ++i) {
+          gui.Begin(camera, viewport);
+          gui.Points({}, positions);
+          g_sink = gui.End().Kind == rectray::HitKind::Point ? 1.0f : 0.0f;
+        }
+      });
+    }
+  }
+
+  // exact picking against a 256k triangle sphere
+  {
+    const uint32_t SEGMENTS = 512;
+    const uint32_t RINGS = SEGMENTS / 2;
+    std::vector<DirectX::XMFLOAT3> vertices;
+    for (uint32_t r = 0; r <= RINGS; ++r) {
+      auto phi = DirectX::XM_PI * r / RINGS;
+      for (uint32_t s = 0; s <= SEGMENTS; ++s) {
+        auto theta = DirectX::XM_2PI * s / SEGMENTS;
+        vertices.push_back({sinf(phi) * cosf(theta), cosf(phi),
+                            sinf(phi) * sinf(theta)});
+      }
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t r = 0; r < RINGS; ++r) {
+      for (uint32_t s = 0; s < SEGMENTS; ++s) {
+        auto i0 = r * (SEGMENTS + 1) + s;
+        auto i1 = i0 + SEGMENTS + 1;
+        indices.insert(indices.end(), {i0, i1, i0 + 1, i0 + 1, i1, i1 + 1});
+      }
+    }
+    auto mesh = rectray::TriangleMesh::Create(vertices, indices);
+    Bench("TriangleMesh::Raycast", COUNT / 100, [&](int n) {
+      int hit = 0;
+      for (int i = 0; i < n; ++i) {
+        rectray::Ray ray{{(float)(i % 100) * 0.02f - 1,
+                          (float)(i / 100 % 100) * 0.02f - 1, -5},
+                         {0, 0, 1}};
+        if (mesh->Raycast(ray)) {
+          ++hit;
+        }
+      }
+      g_sink = (float)hit;
+    });
+  }
+
+  // batch kernels at each level the cpu supports
+  const size_t BATCH = 4096;
+  std::vector<DirectX::XMFLOAT4X4> cubes(BATCH);
+  for (size_t i = 0; i < BATCH; ++i) {
+    DirectX::XMStoreFloat4x4(&cubes[i],
+                             m * DirectX::XMMatrixTranslation(
+                                     (float)(i % 64), (float)(i / 64), 0));
+  }
+  std::vector<DirectX::XMFLOAT3> p0(BATCH);
+  std::vector<DirectX::XMFLOAT3> p1(BATCH);
+  for (size_t i = 0; i < BATCH; ++i) {
+    p0[i] = points[i & 1023];
+    p1[i] = points[(i + 1) & 1023];
+  }
+  std::vector<DirectX::XMFLOAT2> l0(BATCH);
+  std::vector<DirectX::XMFLOAT2> l1(BATCH);
+  for (size_t i = 0; i < BATCH; ++i) {
+    l0[i] = {(float)i, 0};
+    l1[i] = {(float)i, 100};
+  }
+  std::vector<float> f0(BATCH);
+  std::vector<float> f1(BATCH);
+  std::vector<DirectX::XMFLOAT2> out(BATCH * 4);
+  rectray::Ray ray{{0, 0, 10}, {0, 0, -1}};
+  DirectX::XMFLOAT4X4 vp;
+  DirectX::XMStoreFloat4x4(&vp, m);
+
+  // small triangles scattered in front of the ray
+  std::vector<DirectX::XMFLOAT3> triangles(BATCH * 3);
+  std::vector<rectray::kernel::TrianglePacket> packets(
+      BATCH / rectray::kernel::TrianglePacket::WIDTH);
+  for (size_t i = 0; i < BATCH; ++i) {
+    DirectX::XMFLOAT3 c{(float)(i % 64) - 32, (float)(i / 64) - 32,
+                        (float)(i % 7)};
+    triangles[i * 3] = c;
+    triangles[i * 3 + 1] = {c.x + 1, c.y, c.z};
+    triangles[i * 3 + 2] = {c.x, c.y + 1, c.z};
+    packets[i / rectray::kernel::TrianglePacket::WIDTH].Set(
+        i % rectray::kernel::TrianglePacket::WIDTH, triangles[i * 3],
+        triangles[i * 3 + 1], triangles[i * 3 + 2]);
+  }
+  Bench("IntersectsTriangle", COUNT / BATCH * 10, BATCH, [&](int n) {
+    float closest = 0;
+    for (int i = 0; i < n; ++i) {
+      closest = std::numeric_limits<float>::infinity();
+      for (size_t t = 0; t < BATCH; ++t) {
+        if (auto d = rectray::IntersectsTriangle(ray, triangles[t * 3],
+                                                 triangles[t * 3 + 1],
+                                                 triangles[t * 3 + 2]);
+            d && *d < closest) {
+          closest = *d;
+        }
+      }
+    }
+    g_sink = closest;
+  });
+
+  std::vector<float> pixels(BATCH, 4);
+  auto detected = rectray::DetectSimdLevel();
+  for (auto level : {rectray::SimdLevel::None, rectray::SimdLevel::SSE2,
+                     rectray::SimdLevel::AVX2, rectray::SimdLevel::AVX512}) {
+    if (level > detected || rectray::SetSimdLevel(level) != level) {
+      continue;
+    }
+    printf("[kernels: %s]\n", rectray::SimdLevelName(level));
+    const int ROUNDS = COUNT / BATCH * 10;
+    Bench("  IntersectsCubes", ROUNDS, BATCH, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        rectray::kernel::IntersectsCubes(ray, cubes, f0);
+      }
+      g_sink = f0[0];
+    });
+    Bench("  ProjectPoints", ROUNDS, BATCH, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        rectray::kernel::ProjectPoints(vp, 640, 480, p0, out, f0);
+      }
+      g_sink = f0[0];
+    });
+    Bench("  SegmentDistances", ROUNDS, BATCH, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        rectray::kernel::SegmentDistances(ray, p0, p1, f0, f1);
+      }
+      g_sink = f0[0];
+    });
+    Bench("  IntersectsSegments", ROUNDS, BATCH, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        rectray::kernel::IntersectsSegments(ray, p0, p1, pixels, 0.002f, f0);
+      }
+      g_sink = f0[0];
+    });
+    Bench("  ExpandLines", ROUNDS, BATCH, [&](int n) {
+      for (int i = 0; i < n; ++i) {
+        rectray::kernel::ExpandLines(l0, l1, 2.0f, out);
+      }
+      g_sink = out[0].x;
+    });
+    Bench("  CullPoints", ROUNDS, BATCH, [&](int n) {
+      rectray::kernel::PointCull cull{
+          .ViewProjection = vp,
+          .Width = 640,
+          .Height = 480,
+          .Margin = 2,
+          .NearW = 0.1f,
+          .Cursor = {320, 240},
+          .PickRadius = 6,
+      };
+      size_t kept = 0;
+      for (int i = 0; i < n; ++i) {
+        rectray::kernel::PointPick pick;
+        kept = rectray::kernel::CullPoints(cull, p0, out, &pick);
+      }
+      g_sink = (float)kept;
+    });
+    Bench("  IntersectsTriangles", ROUNDS, BATCH, [&](int n) {
+      float closest = 0;
+      for (int i = 0; i < n; ++i) {
+        uint32_t index;
+        closest = rectray::kernel::IntersectsTriangles(ray, packets, &index);
+      }
+      g_sink = closest;
+    });
+  }
+
+  return 0;
+}
@@ -1,10 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <assert.h>
 #include <expected>
 #include <iterator>
 #include <memory>
 #include <optional>
 #include <span>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -151,6 +153,12 @@ public:
     glUniformMatrix4fv(location, 1, GL_FALSE, m);
   }
 
+  void SetFloat(GLuint location, float x) { glUniform1f(location, x); }
+
+  void SetFloat2(GLuint location, float x, float y) {
+    glUniform2f(location, x, y);
+  }
+
   std::optional<GLuint> AttributeLocation(const char *name) {
     auto location = glGetAttribLocation(m_program, name);
     if (location < 0) {
@@ -249,6 +257,8 @@ struct Attribute {
   GLboolean Normalize;
   GLuint Stride;
   GLuint Offset;
+  // 1: per instance
+  GLuint Divisor = 0;
 };
 
 class Vao {
@@ -279,6 +289,9 @@ public:
                             attribute.ElementType, attribute.Normalize,
                             attribute.Stride,
                             (void *)(int64_t)attribute.Offset);
+      if (attribute.Divisor) {
+        glVertexAttribDivisor(attribute.Location, attribute.Divisor);
+      }
     }
     ptr->Unbind();
 
@@ -303,6 +316,48 @@ public:
     }
     Unbind();
   }
+
+  void DrawInstanced(GLenum mode, GLuint count, GLuint instanceCount) {
+    Bind();
+    glDrawArraysInstanced(mode, 0, count, instanceCount);
+    Unbind();
+  }
+
+  // point the attributes at a buffer not owned by a Vbo (StreamBuffer).
+  // offset is added to each Attribute::Offset.
+  void SetAttributes(GLuint buffer, std::span<const Attribute> attributes,
+                     uint32_t offset) {
+    Bind();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (auto &attribute : attributes) {
+      glEnableVertexAttribArray(attribute.Location);
+      glVertexAttribPointer(
+          attribute.Location, attribute.ElementCount, attribute.ElementType,
+          attribute.Normalize, attribute.Stride,
+          (void *)(int64_t)(offset + attribute.Offset));
+      if (attribute.Divisor) {
+        glVertexAttribDivisor(attribute.Location, attribute.Divisor);
+      }
+    }
+    Unbind();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  // element buffer not owned by an Ibo. draw with DrawElements
+  void SetIndices(GLuint buffer) {
+    Bind();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    Unbind();
+  }
+
+  // offset in bytes
+  void DrawElements(GLenum mode, GLuint count, GLenum valuetype,
+                    uint32_t offset) {
+    Bind();
+    glDrawElements(mode, count, valuetype,
+                   reinterpret_cast<void *>(static_cast<uint64_t>(offset)));
+    Unbind();
+  }
 };
 
 struct Ubo {
@@ -342,6 +397,145 @@ struct Ubo {
   }
 };
 
+//
+// Per frame uploads without waiting for the gpu.
+//
+// One buffer object split into FRAMES regions. Each frame writes the next
+// region, so the gpu can still read the previous ones.
+//
+// * desktop: glMapBufferRange unsynchronized. a fence per region guards the
+//   reuse FRAMES frames later. usually already signaled
+// * webgl2 has no buffer mapping: glBufferSubData
+// * a write that does not fit grows the regions. glBufferData(nullptr)
+//   orphans the old storage, draws already issued keep reading it
+//
+// Call NextFrame() once per frame before the writes of the frame.
+// Offsets returned before a grow refer to the orphaned storage. Issue their
+// draws before writing again, or write once per frame.
+//
+class StreamBuffer {
+public:
+  static const uint32_t FRAMES = 3;
+
+private:
+  GLenum m_target;
+  GLuint m_buffer = 0;
+  uint32_t m_alignment;
+  uint32_t m_regionSize = 0;
+  uint32_t m_region = 0;
+  uint32_t m_cursor = 0;
+  GLsync m_fences[FRAMES] = {};
+
+  uint32_t Align(uint32_t n) const {
+    return (n + m_alignment - 1) / m_alignment * m_alignment;
+  }
+
+  void ClearFences() {
+    for (auto &fence : m_fences) {
+      if (fence) {
+        glDeleteSync(fence);
+        fence = nullptr;
+      }
+    }
+  }
+
+  void Grow(uint32_t size) {
+    m_regionSize = Align(std::max({size, m_regionSize * 2, 4096u}));
+    // GL_COPY_WRITE_BUFFER does not touch the bound vao
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, m_regionSize * FRAMES, nullptr,
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    // the new storage is not used by the gpu yet
+    ClearFences();
+  }
+
+public:
+  // alignment of each Write. UniformAlignment() for GL_UNIFORM_BUFFER
+  StreamBuffer(GLenum target, uint32_t alignment = 4)
+      : m_target(target), m_alignment(alignment) {
+    glGenBuffers(1, &m_buffer);
+  }
+  ~StreamBuffer() {
+    ClearFences();
+    glDeleteBuffers(1, &m_buffer);
+  }
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  static std::shared_ptr<StreamBuffer> Create(GLenum target,
+                                              uint32_t alignment = 4) {
+    return std::make_shared<StreamBuffer>(target, alignment);
+  }
+
+  static uint32_t UniformAlignment() {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return std::max(alignment, 4);
+  }
+
+  GLuint Handle() const { return m_buffer; }
+  GLenum Target() const { return m_target; }
+
+  void NextFrame() {
+    // after the draws that read the current region
+    if (m_fences[m_region]) {
+      glDeleteSync(m_fences[m_region]);
+    }
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_region = (m_region + 1) % FRAMES;
+    m_cursor = 0;
+    if (auto fence = m_fences[m_region]) {
+      // written FRAMES frames ago
+#ifdef __EMSCRIPTEN__
+      // webgl does not allow a client wait timeout
+      glClientWaitSync(fence, 0, 0);
+#else
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+#endif
+      glDeleteSync(fence);
+      m_fences[m_region] = nullptr;
+    }
+  }
+
+  // copy to the current region. returns the offset in the buffer
+  uint32_t Write(const void *data, uint32_t size) {
+    auto offset = Align(m_cursor);
+    if (offset + size > m_regionSize) {
+      Grow(offset + size);
+    }
+    auto position = m_region * m_regionSize + offset;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+#ifdef __EMSCRIPTEN__
+    glBufferSubData(GL_COPY_WRITE_BUFFER, position, size, data);
+#else
+    auto p = glMapBufferRange(GL_COPY_WRITE_BUFFER, position, size,
+                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                  GL_MAP_UNSYNCHRONIZED_BIT);
+    if (p) {
+      memcpy(p, data, size);
+      glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    } else {
+      glBufferSubData(GL_COPY_WRITE_BUFFER, position, size, data);
+    }
+#endif
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_cursor = offset + size;
+    return position;
+  }
+  template <typename T> uint32_t Write(std::span<const T> values) {
+    return Write(values.data(), static_cast<uint32_t>(values.size_bytes()));
+  }
+
+  // GL_UNIFORM_BUFFER
+  void BindRange(uint32_t binding_point, uint32_t offset, uint32_t size) {
+    glBindBufferRange(m_target, binding_point, m_buffer, offset, size);
+  }
+};
+
 enum class PixelFormat {
   u8_RGBA,
   u8_RGB,
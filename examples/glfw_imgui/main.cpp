@@ -1,4 +1,5 @@
 #include "gl_api.h"
+#include "marker_renderer.h"
 #include "platform.h"
 #include "renderer.h"
 #include "scene.h"
@@ -6,6 +7,7 @@
 #include <imgui_internal.h>
 #include <memory>
 #include <rectray.h>
+#include <thread>
 
 // This example can also compile and run with Emscripten! See
 // 'Makefile.emscripten' for details.
@@ -19,10 +21,27 @@ struct ViewportGui {
   rectray::Gui Gui;
   float ClearColor[4];
   Renderer Renderer;
+  bool NativeMarkers = false;
+  bool TessellatedMarkers = false;
+  bool Occlusion = false;
+  bool Pipelined = false;
+  void SetPipelined(bool enable) {
+    Pipelined = enable;
+    // waits for the worker before the buffers change
+    Renderer.SetPipelined(enable);
+    Gui.SetDoubleBuffer(enable);
+  }
   void Show() {
     ImGui::Begin(Name.c_str());
     {
       ImGui::ColorEdit3("clear color", ClearColor);
+      if (ImGui::Checkbox("native markers", &NativeMarkers)) {
+        Renderer.SetNativeMarkers(NativeMarkers);
+      }
+      ImGui::SameLine();
+      if (ImGui::Checkbox("tessellated", &TessellatedMarkers)) {
+        Renderer.SetTessellatedMarkers(TessellatedMarkers);
+      }
 
       // camera
       ImGui::Separator();
@@ -44,6 +63,15 @@ struct ViewportGui {
         ImGui::BeginDisabled(true);
       }
 
+      if (ImGui::Checkbox("occlusion", &Occlusion)) {
+        Gui.SetOcclusion(Occlusion);
+      }
+      ImGui::Text("pick: tested %u, pruned %u, culled %u, occluded %u%s",
+                  Gui.m_pickStats.Tested, Gui.m_pickStats.Pruned,
+                  Gui.m_pickStats.Culled, Gui.m_pickStats.Occluded,
+                  Gui.m_pickStats.Coherent ? ", coherent" : "");
+      ImGui::Text("labels: %zu of %zu placed", Gui.Labels().Placed().size(),
+                  Gui.Labels().Size());
       ImGui::TextUnformatted("ray hits");
       for (auto hit : Gui.m_hits) {
         ImGui::Text("hit: %0.3f", hit);
@@ -55,31 +83,71 @@ struct ViewportGui {
   }
   // ImGui::GetWindowDrawList()
   //&mainCamera.Screen
-  void Render(const rectray::ViewportState &viewport, ImDrawList *imDrawList,
-              Scene *scene, const rectray::Gui *other) {
-    Renderer.Render(Gui, Camera, viewport, imDrawList, scene, other);
+  bool Render(const rectray::ViewportState &viewport, ImDrawList *imDrawList,
+              Scene *scene, const rectray::Gui *other,
+              std::span<const rectray::InputEvent> events = {}) {
+    return Renderer.Render(Gui, Camera, viewport, imDrawList, scene, other,
+                           events);
   }
 };
 
+// headless check for CI (xvfb + mesa llvmpipe).
+// draw markers with MarkerRenderer and read the pixels back.
+static int CheckMarkers() {
+  const int W = 64;
+  const int H = 64;
+  const float BLACK[4] = {0, 0, 0, 1};
+  gl::RenderTarget target;
+  target.Begin(W, H, BLACK);
+
+  rectray::DrawList drawlist;
+  // red line at y=16, green triangle below
+  drawlist.AddLine({0, 16}, {64, 16}, 0xFF0000FF, 4);
+  drawlist.AddTriangleFilled({8, 40}, {56, 40}, {32, 60}, 0xFF00FF00);
+  rectray::ViewportState viewport{
+      .ViewportWidth = W,
+      .ViewportHeight = H,
+  };
+  rectray::marker::CompactMarkers compact;
+  compact.Build(drawlist.Markers);
+  {
+    MarkerRenderer renderer;
+    renderer.Render(compact, viewport);
+  }
+
+  // gl origin is bottom left
+  uint8_t line[4];
+  glReadPixels(32, H - 16, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, line);
+  uint8_t triangle[4];
+  glReadPixels(32, H - 45, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, triangle);
+  target.End();
+
+  auto ok = line[0] > 200 && line[1] < 50 && triangle[0] < 50 &&
+            triangle[1] > 200 && glGetError() == GL_NO_ERROR;
+  printf("check markers: line(%d,%d,%d) triangle(%d,%d,%d) %s\n", line[0],
+         line[1], line[2], triangle[0], triangle[1], triangle[2],
+         ok ? "ok" : "failed");
+  return ok ? 0 : 1;
+}
+
 // Main code
-int main(int, char **) {
+int main(int argc, char **argv) {
   Platform platform;
 
   if (!platform.CreateWindow()) {
     return 1;
   }
+  if (argc > 1 && std::string_view(argv[1]) == "--check-markers") {
+    return CheckMarkers();
+  }
   auto &io = ImGui::GetIO();
 
   Scene scene;
   {
-    scene.Objects.push_back(std::make_shared<Object>());
-    scene.Objects.back()->Transform.Translation = {};
-
-    scene.Objects.push_back(std::make_shared<Object>());
-    scene.Objects.back()->Transform.Translation = {2, 0, 0};
-
-    scene.Objects.push_back(std::make_shared<Object>());
-    scene.Objects.back()->Transform.Translation = {0, 2, 0};
+    // a chain. moving the root moves all
+    auto root = scene.Add({0, 0, 0});
+    auto child = scene.Add({2, 0, 0}, root);
+    scene.Add({0, 2, 0}, child);
   }
 
   ViewportGui mainCamera{
@@ -110,7 +178,9 @@ int main(int, char **) {
       },
       .ClearColor{0.3f, 0.3f, 0.3f, 1.0f},
   };
+  mainCamera.Gui.SetWorkerThreads(std::thread::hardware_concurrency());
   auto renderTarget = std::make_shared<gl::RenderTarget>();
+  std::vector<rectray::InputEvent> inputEvents;
 
   // Main loop
 #ifdef __EMSCRIPTEN__
@@ -125,24 +195,99 @@ int main(int, char **) {
 #endif
   {
     platform.UpdateGui();
+    // every mouse sample since the last frame. the main camera drags
+    // through all of them
+    auto &inputStats = platform.Input().Drain(&inputEvents);
 
     static ImVec2 lastMouse = io.MousePos;
+    bool redraw = false;
 
+    // the main camera records on a worker when pipelined. it reads the
+    // scene and the camera the panels below edit
+    mainCamera.Renderer.Wait();
     mainCamera.Show();
     debugCamera.Show();
 
     if (ImGui::Begin("scene")) {
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
                   1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+      ImGui::Text("input: %u samples, %u dropped, oldest %.2f ms (max %.2f)",
+                  inputStats.Events, inputStats.Dropped, inputStats.OldestMs,
+                  inputStats.MaxMs);
+      ImGui::Text("motion to photon %.2f ms, drain to photon %.2f ms",
+                  inputStats.MotionToPhotonMs, inputStats.DrainToPhotonMs);
+      bool idle = platform.IdleMode();
+      if (ImGui::Checkbox("idle mode", &idle)) {
+        platform.SetIdleMode(idle);
+      }
+      ImGui::SameLine();
+      // the debug camera reads the main Gui, so it stays synchronous
+      bool pipelined = mainCamera.Pipelined;
+      if (ImGui::Checkbox("pipelined main camera", &pipelined)) {
+        mainCamera.SetPipelined(pipelined);
+      }
+      // drag where the cursor will be when the frame is shown
+      static bool predict = false;
+      ImGui::Checkbox("predict cursor", &predict);
+      mainCamera.Gui.SetPrediction(predict ? inputStats.DrainToPhotonMs : 0);
       // scene
       ImGui::Separator();
+      if (ImGui::Button("add 1000 cubes")) {
+        // a 10x10x10 grid behind the others
+        auto base = scene.Objects.size();
+        for (int i = 0; i < 1000; ++i) {
+          scene.Add({(float)(i % 10) * 2 - 9, (float)(i / 10 % 10) * 2 - 9,
+                     -(float)(i / 100) * 2 - 4 - (float)(base / 1000) * 20});
+        }
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("add child") && scene.Selected) {
+        scene.Selected = scene.Add({1.5f, 0, 0}, scene.Selected);
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("remove") && scene.Selected) {
+        scene.Remove(scene.Selected);
+      }
+      ImGui::SameLine();
+      ImGui::Text("%zu objects", scene.Objects.size());
+      ImGui::Checkbox("vertex snap", &scene.VertexSnap);
+      ImGui::SameLine();
+      // drag the white center handle
+      ImGui::Checkbox("drop to surface", &scene.SurfaceDrag);
+      ImGui::SameLine();
+      ImGui::Checkbox("labels", &scene.Labels);
+      if (ImGui::Button("add sphere mesh")) {
+        scene.AddSphere({-3.0f * (float)(scene.Meshes.size() + 1), 0, 0},
+                        512);
+      }
+      ImGui::SameLine();
+      ImGui::Checkbox("wireframe", &scene.MeshWireframe);
+      ImGui::SameLine();
+      ImGui::Text("%zu meshes", scene.Meshes.size());
+      if (ImGui::Button("add 1M points")) {
+        scene.AddPoints(1000000);
+      }
+      ImGui::SameLine();
+      if (auto index = scene.SelectedPoint) {
+        auto &p = scene.Points[*index];
+        ImGui::Text("%zu points, selected #%u (%.2f, %.2f, %.2f)",
+                    scene.Points.size(), *index, p.x, p.y, p.z);
+      } else {
+        ImGui::Text("%zu points", scene.Points.size());
+      }
       ImGui::SetNextItemOpen(true, ImGuiCond_Appearing);
       if (ImGui::TreeNode("[objects]")) {
         int clicked = 0;
         for (int i = 0; i < scene.Objects.size(); ++i) {
           auto &o = scene.Objects[i];
+          int depth = 0;
+          for (auto parent = scene.Transforms.Hierarchy.Parent(i);
+               parent != rectray::TransformHierarchy::ROOT;
+               parent = scene.Transforms.Hierarchy.Parent(parent)) {
+            ++depth;
+          }
           char buf[256];
-          snprintf(buf, std::size(buf), "%d", i);
+          snprintf(buf, std::size(buf), "%*s%d", depth * 2, "", i);
           if (ImGui::Selectable(buf, o == scene.Selected)) {
             ++clicked;
             scene.Selected = o;
@@ -197,8 +342,8 @@ int main(int, char **) {
             .MouseWheel = io.MouseWheel,
         };
 
-        debugCamera.Render(viewport, ImGui::GetWindowDrawList(), &scene,
-                           &mainCamera.Gui);
+        redraw |= debugCamera.Render(viewport, ImGui::GetWindowDrawList(),
+                                     &scene, &mainCamera.Gui);
 
         renderTarget->End();
       }
@@ -240,12 +385,20 @@ int main(int, char **) {
                    mainCamera.ClearColor[3]);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-      mainCamera.Render(viewport, ImGui::GetBackgroundDrawList(), &scene,
-                        &debugCamera.Gui);
+      redraw |= mainCamera.Render(viewport, ImGui::GetBackgroundDrawList(),
+                                  &scene, &debugCamera.Gui, inputEvents);
+    }
+
+    // camera drag and imgui widgets keep animating too
+    if (redraw || ImGui::IsAnyItemActive() || io.MouseDown[1] ||
+        io.MouseDown[2] || io.MouseWheel != 0) {
+      platform.RequestRedraw();
     }
 
     lastMouse = io.MousePos;
     platform.EndFrame();
+    // a pipelined frame is shown one swap after its Drain()
+    platform.Input().Presented(mainCamera.Pipelined ? 1 : 0);
   }
 #ifdef __EMSCRIPTEN__
   EMSCRIPTEN_MAINLOOP_END;
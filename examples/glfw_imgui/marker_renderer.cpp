@@ -0,0 +1,204 @@
+#include "marker_renderer.h"
+#include "gl_api.h"
+#include <rectray.h>
+
+// thick line as a quad per instance. corners from gl_VertexID (strip 0-3)
+const auto LINE_VS = R"(
+in vec4 aLine;
+in vec4 aColor;
+in float aThickness;
+uniform vec2 uViewportSize;
+uniform float uScale;
+out vec4 vColor;
+void main() {
+    vec2 p0 = aLine.xy * uScale;
+    vec2 p1 = aLine.zw * uScale;
+    vec2 d = p1 - p0;
+    float len = length(d);
+    vec2 dir = len > 0.0 ? d / len : vec2(1.0, 0.0);
+    vec2 n = vec2(-dir.y, dir.x);
+    float along = float(gl_VertexID / 2);
+    float side = float(gl_VertexID % 2) * 2.0 - 1.0;
+    float halfWidth = max(aThickness, 1.0) * 0.5;
+    vec2 p = mix(p0, p1, along) + n * side * halfWidth;
+    vec2 ndc = p / uViewportSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    vColor = aColor;
+}
+)";
+
+const auto TRIANGLE_VS = R"(
+in vec2 aPos;
+in vec4 aColor;
+uniform vec2 uViewportSize;
+uniform float uScale;
+out vec4 vColor;
+void main() {
+    vec2 ndc = aPos * uScale / uViewportSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    vColor = aColor;
+}
+)";
+
+const auto FS = R"(
+in vec4 vColor;
+out vec4 FragColor;
+void main() {
+    FragColor = vColor;
+}
+)";
+
+struct LineInstance {
+  int16_t X0;
+  int16_t Y0;
+  int16_t X1;
+  int16_t Y1;
+  uint32_t Color;
+  float Thickness;
+};
+static_assert(sizeof(LineInstance) == 16);
+
+struct Program {
+  std::shared_ptr<gl::ShaderProgram> Shader;
+  GLuint ViewportSize = -1;
+  GLuint Scale = -1;
+
+  Program(const char *vs) {
+    Shader = gl::ShaderProgram::FromSource(vs, FS);
+    if (auto location = Shader->UniformLocation("uViewportSize")) {
+      ViewportSize = *location;
+    }
+    if (auto location = Shader->UniformLocation("uScale")) {
+      Scale = *location;
+    }
+  }
+
+  GLuint Attribute(const char *name) {
+    if (auto location = Shader->AttributeLocation(name)) {
+      return *location;
+    }
+    assert(false);
+    return 0;
+  }
+
+  // scale of the CompactMarkers
+  void Use(const rectray::ViewportState &viewport, float scale) {
+    Shader->Use();
+    Shader->SetFloat2(ViewportSize, viewport.ViewportWidth,
+                      viewport.ViewportHeight);
+    Shader->SetFloat(Scale, 1.0f / scale);
+  }
+};
+
+struct MarkerRendererImpl {
+  Program m_line{LINE_VS};
+  Program m_triangle{TRIANGLE_VS};
+  std::vector<gl::Attribute> m_lineAttributes;
+  std::vector<gl::Attribute> m_triangleAttributes;
+  // one write per frame each. see gl::StreamBuffer
+  gl::StreamBuffer m_lines{GL_ARRAY_BUFFER, sizeof(LineInstance)};
+  gl::StreamBuffer m_vertices{GL_ARRAY_BUFFER,
+                              sizeof(rectray::marker::CompactVertex)};
+  gl::StreamBuffer m_indices{GL_ELEMENT_ARRAY_BUFFER};
+  gl::Vao m_lineVao;
+  gl::Vao m_triangleVao;
+  std::vector<LineInstance> m_instances;
+
+  MarkerRendererImpl() {
+    m_lineAttributes = {
+        {m_line.Attribute("aLine"), 4, GL_SHORT, GL_FALSE,
+         sizeof(LineInstance), offsetof(LineInstance, X0), 1},
+        {m_line.Attribute("aColor"), 4, GL_UNSIGNED_BYTE, GL_TRUE,
+         sizeof(LineInstance), offsetof(LineInstance, Color), 1},
+        {m_line.Attribute("aThickness"), 1, GL_FLOAT, GL_FALSE,
+         sizeof(LineInstance), offsetof(LineInstance, Thickness), 1},
+    };
+    using rectray::marker::CompactVertex;
+    m_triangleAttributes = {
+        {m_triangle.Attribute("aPos"), 2, GL_SHORT, GL_FALSE,
+         sizeof(CompactVertex), offsetof(CompactVertex, X)},
+        {m_triangle.Attribute("aColor"), 4, GL_UNSIGNED_BYTE, GL_TRUE,
+         sizeof(CompactVertex), offsetof(CompactVertex, Color)},
+    };
+    m_triangleVao.SetIndices(m_indices.Handle());
+    assert(glGetError() == GL_NO_ERROR);
+  }
+
+  void BuildLineInstances(const rectray::marker::CompactMarkers &markers) {
+    m_instances.clear();
+    auto &vertices = markers.Vertices();
+    auto index16 = (const uint16_t *)markers.LineIndices();
+    auto index32 = (const uint32_t *)markers.LineIndices();
+    auto index = [&](uint32_t i) -> uint32_t {
+      return markers.IndexSize() == 4 ? index32[i] : index16[i];
+    };
+    for (auto &batch : markers.LineBatches()) {
+      auto end = batch.IndexOffset + batch.IndexCount;
+      for (auto i = batch.IndexOffset; i + 1 < end; i += 2) {
+        auto &v0 = vertices[index(i)];
+        auto &v1 = vertices[index(i + 1)];
+        m_instances.push_back(
+            {v0.X, v0.Y, v1.X, v1.Y, v0.Color, batch.Thickness});
+      }
+    }
+  }
+
+  void Render(const rectray::marker::CompactMarkers &markers,
+              const rectray::ViewportState &viewport) {
+    m_lines.NextFrame();
+    m_vertices.NextFrame();
+    m_indices.NextFrame();
+
+    auto depthTest = glIsEnabled(GL_DEPTH_TEST);
+    auto blend = glIsEnabled(GL_BLEND);
+    GLint srcRgb, dstRgb, srcAlpha, dstAlpha;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &srcRgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &dstRgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &srcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &dstAlpha);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (auto count = markers.TriangleIndexCount()) {
+      auto &vertices = markers.Vertices();
+      auto vertexOffset = m_vertices.Write(
+          std::span<const rectray::marker::CompactVertex>(vertices));
+      auto indexOffset = m_indices.Write(markers.TriangleIndices(),
+                                         count * markers.IndexSize());
+      m_triangleVao.SetAttributes(m_vertices.Handle(), m_triangleAttributes,
+                                  vertexOffset);
+
+      m_triangle.Use(viewport, markers.Scale());
+      m_triangleVao.DrawElements(GL_TRIANGLES, count,
+                                 markers.IndexSize() == 4 ? GL_UNSIGNED_INT
+                                                          : GL_UNSIGNED_SHORT,
+                                 indexOffset);
+    }
+
+    BuildLineInstances(markers);
+    if (!m_instances.empty()) {
+      auto offset = m_lines.Write(std::span<const LineInstance>(m_instances));
+      m_lineVao.SetAttributes(m_lines.Handle(), m_lineAttributes, offset);
+      m_line.Use(viewport, markers.Scale());
+      m_lineVao.DrawInstanced(GL_TRIANGLE_STRIP, 4, m_instances.size());
+    }
+
+    if (depthTest) {
+      glEnable(GL_DEPTH_TEST);
+    }
+    glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha);
+    if (!blend) {
+      glDisable(GL_BLEND);
+    }
+  }
+};
+
+MarkerRenderer::MarkerRenderer() : m_impl(new MarkerRendererImpl) {}
+
+MarkerRenderer::~MarkerRenderer() { delete m_impl; }
+
+void MarkerRenderer::Render(const rectray::marker::CompactMarkers &markers,
+                            const rectray::ViewportState &viewport) {
+  m_impl->Render(markers, viewport);
+}
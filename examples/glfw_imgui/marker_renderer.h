@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+namespace rectray {
+struct ViewportState;
+namespace marker {
+class CompactMarkers;
+}
+} // namespace rectray
+
+// draws rectray lines and triangles with GL.
+// one instanced draw for all lines, one indexed draw for all triangles.
+// text is not drawn.
+class MarkerRenderer {
+  struct MarkerRendererImpl *m_impl;
+
+public:
+  MarkerRenderer();
+  ~MarkerRenderer();
+  // into the current framebuffer. glViewport covers the rectray viewport.
+  void Render(const rectray::marker::CompactMarkers &markers,
+              const rectray::ViewportState &viewport);
+};
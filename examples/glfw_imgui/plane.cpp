@@ -108,7 +108,7 @@ void main() {
 
 struct PlaneImpl {
   std::shared_ptr<gl::ShaderProgram> m_shader;
-  std::shared_ptr<gl::Ubo> m_ubo;
+  std::shared_ptr<gl::StreamBuffer> m_ubo;
   std::shared_ptr<gl::Vao> m_vao;
 
   struct ViewUniforms {
@@ -120,7 +120,8 @@ struct PlaneImpl {
 
   PlaneImpl() {
     m_shader = gl::ShaderProgram::FromSource(VS, FS);
-    m_ubo = gl::Ubo::Create(m_ubo_data);
+    m_ubo = gl::StreamBuffer::Create(GL_UNIFORM_BUFFER,
+                                     gl::StreamBuffer::UniformAlignment());
 
     // Grid position are in xy clipped space
     DirectX::XMFLOAT3 GridPlane[] = {
@@ -144,8 +145,10 @@ struct PlaneImpl {
     m_ubo_data.pos.x = 0.01f;  // camera.Projection.NearZ;
     m_ubo_data.pos.y = 100.0f; // camera.Projection.FarZ;
 
-    m_ubo->Upload(m_ubo_data);
-    m_ubo->SetBindingPoint(0);
+    // no stall on the camera moving every frame
+    m_ubo->NextFrame();
+    auto offset = m_ubo->Write(&m_ubo_data, sizeof(m_ubo_data));
+    m_ubo->BindRange(0, offset, sizeof(m_ubo_data));
 
     m_shader->UboBind(0, 0);
     m_shader->Use();
@@ -14,9 +14,45 @@ static void glfw_error_callback(int error, const char *description) {
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
+#include <rectray/input.h>
+
+// frames rendered at full rate after input or a redraw request
+const int REDRAW_FRAMES = 3;
+// wake up periodically even if no input arrives
+const double IDLE_TIMEOUT_SECONDS = 0.5;
 
 struct PlatformImpl {
   GLFWwindow *Window = nullptr;
+  bool IdleMode = true;
+  int RedrawFrames = REDRAW_FRAMES;
+  // every mouse sample, filled by the callbacks below
+  rectray::InputQueue Input;
+
+  static rectray::InputQueue &InputOf(GLFWwindow *window) {
+    return static_cast<PlatformImpl *>(glfwGetWindowUserPointer(window))
+        ->Input;
+  }
+  static void CursorPosCallback(GLFWwindow *window, double x, double y) {
+    InputOf(window).Push({
+        .Type = rectray::InputType::Move,
+        .X = static_cast<float>(x),
+        .Y = static_cast<float>(y),
+    });
+  }
+  static void MouseButtonCallback(GLFWwindow *window, int button, int action,
+                                  int) {
+    InputOf(window).Push({
+        .Type = rectray::InputType::Button,
+        .Button = static_cast<uint8_t>(button),
+        .Down = action == GLFW_PRESS,
+    });
+  }
+  static void ScrollCallback(GLFWwindow *window, double, double y) {
+    InputOf(window).Push({
+        .Type = rectray::InputType::Wheel,
+        .Wheel = static_cast<float>(y),
+    });
+  }
 
   PlatformImpl() { glfwSetErrorCallback(glfw_error_callback); }
 
@@ -67,6 +103,11 @@ struct PlatformImpl {
     }
 
     glfwMakeContextCurrent(Window);
+    // before the imgui backend, which chains to these
+    glfwSetWindowUserPointer(Window, this);
+    glfwSetCursorPosCallback(Window, CursorPosCallback);
+    glfwSetMouseButtonCallback(Window, MouseButtonCallback);
+    glfwSetScrollCallback(Window, ScrollCallback);
     glfwSwapInterval(1); // Enable vsync
                          //
 #ifdef __EMSCRIPTEN__
@@ -129,10 +170,20 @@ struct PlatformImpl {
     if (glfwWindowShouldClose(Window)) {
       return {};
     }
-    glfwPollEvents();
+    if (IdleMode && RedrawFrames <= 0) {
+      // nothing is moving. block until input arrives
+      glfwWaitEventsTimeout(IDLE_TIMEOUT_SECONDS);
+      // this frame counts as the first one
+      RedrawFrames = REDRAW_FRAMES - 1;
+    } else {
+      glfwPollEvents();
+      --RedrawFrames;
+    }
     return true;
   }
 
+  void RequestRedraw() { RedrawFrames = REDRAW_FRAMES; }
+
   void UpdateGui() {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -157,3 +208,14 @@ bool Platform::BeginFrame() { return m_impl->BeginFrame(); }
 void Platform::UpdateGui() { m_impl->UpdateGui(); }
 
 void Platform::EndFrame() { m_impl->EndFrame(); }
+
+void Platform::RequestRedraw() { m_impl->RequestRedraw(); }
+
+rectray::InputQueue &Platform::Input() { return m_impl->Input; }
+
+bool Platform::IdleMode() const { return m_impl->IdleMode; }
+
+void Platform::SetIdleMode(bool enable) {
+  m_impl->IdleMode = enable;
+  m_impl->RequestRedraw();
+}
@@ -2,6 +2,10 @@
 #include <optional>
 #include <tuple>
 
+namespace rectray {
+class InputQueue;
+} // namespace rectray
+
 class Platform {
   struct PlatformImpl *m_impl;
 
@@ -12,4 +16,10 @@ public:
   bool BeginFrame();
   void UpdateGui();
   void EndFrame();
+  // keep polling at full rate for the next few frames
+  void RequestRedraw();
+  // mouse samples from the glfw callbacks. drain once a frame
+  rectray::InputQueue &Input();
+  bool IdleMode() const;
+  void SetIdleMode(bool enable);
 };
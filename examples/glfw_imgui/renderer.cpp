@@ -1,5 +1,6 @@
 #include "renderer.h"
 #include "gl_api.h"
+#include "marker_renderer.h"
 #include "plane.h"
 #include "scene.h"
 #include "triangle.h"
@@ -11,82 +12,220 @@
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <imgui.h>
 
+// emits rectray markers without touching them.
+// the viewport offset is added on the fly.
 struct ImGuiVisitor {
   ImDrawList *m_drawlist;
-  const rectray::marker::Command &m_command;
   ImVec2 m_offset;
+  // reused for offset polyline points
+  std::vector<ImVec2> &m_points;
 
-  inline const ImVec2 IM(const DirectX::XMFLOAT2 &p) {
+  inline const ImVec2 IM(const DirectX::XMFLOAT2 &p) const {
     return m_offset + *((const ImVec2 *)&p);
   };
 
-  void operator()(rectray::marker::Line &shape) {
-    if (m_command.Thickness) {
-      m_drawlist->AddLine(IM(shape.P0), IM(shape.P1), m_command.Color,
-                          *m_command.Thickness);
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Line &shape) {
+    if (command.Thickness) {
+      m_drawlist->AddLine(IM(shape.P0), IM(shape.P1), command.Color,
+                          *command.Thickness);
     } else {
     }
   }
-  void operator()(rectray::marker::Triangle &shape) {
-    if (m_command.Thickness) {
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Triangle &shape) {
+    if (command.Thickness) {
     } else {
       m_drawlist->AddTriangleFilled(IM(shape.P0), IM(shape.P1), IM(shape.P2),
-                                    m_command.Color);
+                                    command.Color);
     }
   }
-  void operator()(rectray::marker::Circle &shape) {
-    if (m_command.Thickness) {
-      m_drawlist->AddCircle(IM(shape.Center), shape.Radius, m_command.Color,
-                            shape.Segments, *m_command.Thickness);
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Circle &shape) {
+    if (command.Thickness) {
+      m_drawlist->AddCircle(IM(shape.Center), shape.Radius, command.Color,
+                            shape.Segments, *command.Thickness);
     } else {
       m_drawlist->AddCircleFilled(IM(shape.Center), shape.Radius,
-                                  m_command.Color, shape.Segments);
+                                  command.Color, shape.Segments);
     }
   }
-  void operator()(rectray::marker::Polyline &shape) {
-    std::span<ImVec2> span{(ImVec2 *)shape.Points.data(), shape.Points.size()};
-    for (auto &p : span) {
-      p += m_offset;
-    }
-    if (m_command.Thickness) {
-      m_drawlist->AddPolyline(span.data(), span.size(), m_command.Color, 0,
-                              *m_command.Thickness);
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Polyline &shape) {
+    m_points.resize(shape.Points.size());
+    for (size_t i = 0; i < shape.Points.size(); ++i) {
+      m_points[i] = IM(shape.Points[i]);
+    }
+    if (command.Thickness) {
+      m_drawlist->AddPolyline(m_points.data(), m_points.size(), command.Color,
+                              0, *command.Thickness);
     } else {
-      m_drawlist->AddConvexPolyFilled(span.data(), span.size(),
-                                      m_command.Color);
+      m_drawlist->AddConvexPolyFilled(m_points.data(), m_points.size(),
+                                      command.Color);
+    }
+  }
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Points &shape) {
+    auto r = ImVec2{shape.Radius, shape.Radius};
+    for (auto &center : shape.Centers) {
+      auto c = IM(center);
+      m_drawlist->AddRectFilled(c - r, c + r, command.Color);
+    }
+  }
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Lines &shape) {
+    auto thickness = command.Thickness.value_or(1.0f);
+    for (size_t i = 1; i < shape.Points.size(); i += 2) {
+      m_drawlist->AddLine(IM(shape.Points[i - 1]), IM(shape.Points[i]),
+                          command.Color, thickness);
     }
   }
-  void operator()(rectray::marker::Text &shape) {
-    m_drawlist->AddText(IM(shape.Pos), m_command.Color, shape.Label.data(),
+  void operator()(const rectray::marker::Command &command,
+                  const rectray::marker::Text &shape) {
+    m_drawlist->AddText(IM(shape.Pos), command.Color, shape.Label.data(),
                         shape.Label.data() + shape.Label.size());
   }
 };
+// the tessellated markers into an imgui draw list. batches of triangles fit
+// 16 bit indices, PrimReserve() moves the vertex offset between them
+static void DrawTriangles(const rectray::marker::Tessellator &tessellator,
+                          const ImVec2 &offset, ImDrawList *drawlist) {
+  auto vertices = tessellator.Vertices();
+  auto indices = tessellator.Indices();
+  auto uv = ImGui::GetFontTexUvWhitePixel();
+  const uint32_t LIMIT = 0xFFFF;
+  size_t begin = 0;
+  while (begin < indices.size()) {
+    auto first =
+        std::min({indices[begin], indices[begin + 1], indices[begin + 2]});
+    auto last = first;
+    auto end = begin;
+    for (; end < indices.size(); end += 3) {
+      auto lo = std::min({indices[end], indices[end + 1], indices[end + 2]});
+      auto hi = std::max({indices[end], indices[end + 1], indices[end + 2]});
+      if (lo < first || hi - first >= LIMIT) {
+        break;
+      }
+      last = std::max(last, hi);
+    }
+    if (end == begin) {
+      // a triangle wider than a batch
+      begin += 3;
+      continue;
+    }
+    drawlist->PrimReserve(static_cast<int>(end - begin),
+                          static_cast<int>(last - first + 1));
+    auto base = drawlist->_VtxCurrentIdx;
+    for (auto i = first; i <= last; ++i) {
+      auto &v = vertices[i];
+      drawlist->PrimWriteVtx(offset + ImVec2{v.Pos.x, v.Pos.y}, uv, v.Color);
+    }
+    for (auto i = begin; i < end; ++i) {
+      drawlist->PrimWriteIdx(
+          static_cast<ImDrawIdx>(base + indices[i] - first));
+    }
+    begin = end;
+  }
+}
+
 struct RendererImpl {
   Plane m_plane;
   Triangle m_triangle;
+  std::vector<ImVec2> m_points;
+  MarkerRenderer m_markers;
+  rectray::marker::CompactMarkers m_compact;
+  bool m_nativeMarkers = false;
+  rectray::marker::Tessellator m_tessellator;
+  // for m_tessellator. started once
+  rectray::WorkerPool m_workers{std::thread::hardware_concurrency()};
+  bool m_tessellate = false;
+  rectray::FramePipeline m_pipeline;
+
+  // what Draw() needs of a recorded frame
+  struct Frame {
+    rectray::marker::View Markers;
+    // after the record
+    rectray::Camera Camera;
+    bool Redraw = false;
+  };
+  // written by the worker when pipelined
+  Frame m_frame;
 
 public:
   RendererImpl() {}
 
-  void Render(rectray::Gui &gui, rectray::Camera &camera,
+  void SetPipelined(bool enable) { m_pipeline.SetLatency(enable ? 1 : 0); }
+  bool Pipelined() const { return m_pipeline.Latency() > 0; }
+  void Wait() { m_pipeline.Wait(); }
+
+  bool Render(rectray::Gui &gui, rectray::Camera &camera,
               const rectray::ViewportState &viewport, ImDrawList *imDrawList,
-              Scene *scene, const rectray::Gui *other) {
+              Scene *scene, const rectray::Gui *other,
+              std::span<const rectray::InputEvent> events) {
+    if (!Pipelined()) {
+      m_frame = Record(gui, camera, viewport, scene, other, events);
+      Draw(m_frame, viewport, imDrawList);
+      return m_frame.Redraw;
+    }
+
+    // draw the last frame while the worker records this one
+    m_pipeline.Wait();
+    auto frame = m_frame;
+    m_pipeline.Submit([this, &gui, &camera, viewport, scene, other,
+                       events = std::vector(events.begin(), events.end())]() {
+      m_frame = Record(gui, camera, viewport, scene, other, events);
+    });
+    Draw(frame, viewport, imDrawList);
+    // this frame's result shows in the next one
+    return true;
+  }
+
+  // gizmos, picking and markers. no imgui or gl
+  Frame Record(rectray::Gui &gui, rectray::Camera &camera,
+               const rectray::ViewportState &viewport, Scene *scene,
+               const rectray::Gui *other,
+               std::span<const rectray::InputEvent> events) {
     // only ViewportX update
     camera.Projection.SetAspectRatio(viewport.ViewportWidth,
                                      viewport.ViewportHeight);
     camera.Update();
 
-    gui.Begin(camera, viewport);
+    gui.Begin(camera, viewport, events);
 
-    for (auto &o : scene->Objects) {
-      auto m = o->Matrix();
-      gui.Cube(o.get(), m);
-      if (o == scene->Selected) {
-        DirectX::XMFLOAT4X4 matrix;
-        DirectX::XMStoreFloat4x4(&matrix, m);
-        if (gui.Translate(rectray::Space::Local, &matrix)) {
-          o->SetMatrix(DirectX::XMLoadFloat4x4(&matrix));
-        }
+    auto &transforms = scene->Transforms;
+    transforms.Update();
+    gui.Cubes(transforms.Matrices, scene->Handles);
+    gui.Points({}, scene->Points);
+    for (auto &instance : scene->Meshes) {
+      gui.Mesh(instance.Handle, instance.Mesh,
+               DirectX::XMLoadFloat4x4(&instance.Matrix),
+               scene->MeshWireframe);
+    }
+    if (scene->VertexSnap) {
+      gui.SetSnapTargets([scene]() { return scene->SnapTargets(); });
+    } else {
+      gui.SetSnapTargets({});
+    }
+    if (scene->SurfaceDrag) {
+      gui.SetSurfaceQuery([scene]() { return scene->SurfaceQuery(); });
+    } else {
+      gui.SetSurfaceQuery({});
+    }
+    if (scene->Labels) {
+      // imgui's default font is 7 x 13 pixels a glyph
+      char text[32];
+      for (uint32_t i = 0; i < scene->Objects.size(); ++i) {
+        auto n = snprintf(text, sizeof(text), "cube #%u", i);
+        gui.Label(rectray::MatrixPosition(transforms.Matrices[i]),
+                  {text, static_cast<size_t>(n)}, {7.0f * n, 13.0f},
+                  scene->Objects[i] == scene->Selected ? 1.0f : 0.0f,
+                  rectray::WHITE, rectray::TextStorage::Interned);
+      }
+    }
+    if (auto o = scene->Selected) {
+      auto matrix = transforms.Matrices[o->Index];
+      if (gui.Translate(rectray::Space::Local, &matrix)) {
+        transforms.SetMatrix(o->Index, DirectX::XMLoadFloat4x4(&matrix));
       }
     }
 
@@ -95,11 +234,17 @@ public:
     if (!result.Drag) {
       camera.MouseInputTurntable(viewport);
       if (viewport.MouseLeftDown) {
-        for (auto &o : scene->Objects) {
-          if (o.get() == result.Closest) {
+        switch (result.Kind) {
+        case rectray::HitKind::Cube:
+          if (auto o = scene->Resolve(result.Closest)) {
             scene->Selected = o;
-            break;
           }
+          break;
+        case rectray::HitKind::Point:
+          scene->SelectedPoint = result.Index;
+          break;
+        default:
+          break;
         }
       }
     }
@@ -108,16 +253,39 @@ public:
       gui.Debug(*other);
     }
 
-    auto drawlist = gui.DrawList();
-    drawlist.ToMarker(camera, viewport);
-    for (auto &c : drawlist.Markers) {
-      std::visit(
-          ImGuiVisitor{imDrawList, c, {viewport.ViewportX, viewport.ViewportY}},
-          c.Shape);
+    return {gui.Render(camera), camera, result.Redraw};
+  }
+
+  void Draw(const Frame &frame, const rectray::ViewportState &viewport,
+            ImDrawList *imDrawList) {
+    auto &markers = frame.Markers;
+    ImGuiVisitor visitor{
+        imDrawList, {markers.Offset.x, markers.Offset.y}, m_points};
+    // text stays on imgui
+    auto drawText = [&markers, &visitor](std::span<const uint32_t> texts) {
+      for (auto i : texts) {
+        auto &command = markers.Markers[i];
+        std::visit([&](const auto &shape) { visitor(command, shape); },
+                   command.Shape);
+      }
+    };
+    if (m_nativeMarkers) {
+      m_compact.Build(markers.Markers, std::max(viewport.ViewportWidth,
+                                                viewport.ViewportHeight));
+      drawText(m_compact.TextMarkers());
+    } else if (m_tessellate) {
+      m_tessellator.Build(markers.Markers, &m_workers);
+      DrawTriangles(m_tessellator, visitor.m_offset, imDrawList);
+      drawText(m_tessellator.TextMarkers());
+    } else {
+      markers.Visit(visitor);
     }
 
-    m_triangle.Render(camera);
-    m_plane.Render(camera);
+    m_triangle.Render(frame.Camera);
+    m_plane.Render(frame.Camera);
+    if (m_nativeMarkers) {
+      m_markers.Render(m_compact, viewport);
+    }
   }
 };
 
@@ -127,9 +295,23 @@ Renderer::Renderer() : m_impl(new RendererImpl) {
 
 Renderer::~Renderer() { delete m_impl; }
 
-void Renderer::Render(rectray::Gui &gui, rectray::Camera &camera,
+void Renderer::SetNativeMarkers(bool enable) {
+  m_impl->m_nativeMarkers = enable;
+}
+
+void Renderer::SetTessellatedMarkers(bool enable) {
+  m_impl->m_tessellate = enable;
+}
+
+void Renderer::SetPipelined(bool enable) { m_impl->SetPipelined(enable); }
+
+void Renderer::Wait() { m_impl->Wait(); }
+
+bool Renderer::Render(rectray::Gui &gui, rectray::Camera &camera,
                       const rectray::ViewportState &viewport,
                       struct ImDrawList *imDrawList, struct Scene *scene,
-                      const rectray::Gui *other) {
-  m_impl->Render(gui, camera, viewport, imDrawList, scene, other);
+                      const rectray::Gui *other,
+                      std::span<const rectray::InputEvent> events) {
+  return m_impl->Render(gui, camera, viewport, imDrawList, scene, other,
+                        events);
 }
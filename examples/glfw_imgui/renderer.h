@@ -1,9 +1,11 @@
 #pragma once
+#include <span>
 
 namespace rectray {
 struct Camera;
 struct ViewportState;
 class Gui;
+struct InputEvent;
 } // namespace rectray
 
 class Renderer {
@@ -12,8 +14,21 @@ class Renderer {
 public:
   Renderer();
   ~Renderer();
-  void Render(rectray::Gui &gui, rectray::Camera &camera,
+  // lines and triangles by MarkerRenderer instead of ImDrawList
+  void SetNativeMarkers(bool enable);
+  // markers as rectray's triangles through ImDrawList. without native
+  // markers
+  void SetTessellatedMarkers(bool enable);
+  // record the gizmos on a worker while the last frame is drawn. one frame
+  // of latency. use with Gui::SetDoubleBuffer(true)
+  void SetPipelined(bool enable);
+  // the worker is done with gui, camera and scene
+  void Wait();
+  // returns true if rectray wants another frame.
+  // events: the mouse samples of the frame for Gui::Begin()
+  bool Render(rectray::Gui &gui, rectray::Camera &camera,
               const rectray::ViewportState &viewport,
               struct ImDrawList *ImDrawList, struct Scene *scene,
-              const rectray::Gui *other = nullptr);
+              const rectray::Gui *other = nullptr,
+              std::span<const rectray::InputEvent> events = {});
 };
@@ -1,34 +1,296 @@
 #pragma once
+#include <cmath>
 #include <list>
 #include <memory>
+#include <optional>
+#include <random>
 #include <rectray.h>
 #include <vector>
 
-struct Object {
-  DirectX::XMFLOAT3 Shape{1, 1, 1};
-  rectray::EuclideanTransform Transform;
+// transforms as separate arrays. index is Object::Index
+struct TransformStore {
+  // rotation and translation. parents before children
+  rectray::TransformHierarchy Hierarchy;
+  // not inherited by children
+  std::vector<DirectX::XMFLOAT3> Scales;
+  // Scaling * world. recomputed by Update() for the changed nodes
+  std::vector<DirectX::XMFLOAT4X4> Matrices;
+  // incremented when Matrices change
+  uint64_t Version = 0;
+
+  size_t Size() const { return Scales.size(); }
+
+  uint32_t Add(const DirectX::XMFLOAT3 &position,
+               int32_t parent = rectray::TransformHierarchy::ROOT,
+               const DirectX::XMFLOAT3 &scale = {1, 1, 1}) {
+    auto index = Hierarchy.Add({.Translation = position}, parent);
+    Scales.push_back(scale);
+    Matrices.push_back({});
+    return index;
+  }
+
+  void Update() {
+    Hierarchy.Update();
+    if (!Hierarchy.Changed().empty()) {
+      ++Version;
+    }
+    for (auto i : Hierarchy.Changed()) {
+      auto &s = Scales[i];
+      DirectX::XMStoreFloat4x4(
+          &Matrices[i], DirectX::XMMatrixScaling(s.x, s.y, s.z) *
+                            DirectX::XMLoadFloat4x4(&Hierarchy.World(i)));
+    }
+  }
 
-  DirectX::XMMATRIX Matrix() const {
-    return DirectX::XMMatrixMultiply(
-        DirectX::XMMatrixScaling(Shape.x, Shape.y, Shape.z),
-        Transform.Matrix());
+  // a leaf only. later rows shift down by one
+  bool Remove(uint32_t i) {
+    if (!Hierarchy.Remove(i)) {
+      return false;
+    }
+    Scales.erase(Scales.begin() + i);
+    Matrices.erase(Matrices.begin() + i);
+    ++Version;
+    return true;
   }
 
-  bool SetMatrix(const DirectX::XMMATRIX m) {
+  // world matrix from the gizmo. the children follow
+  bool SetMatrix(uint32_t i, const DirectX::XMMATRIX m) {
     DirectX::XMVECTOR s;
     DirectX::XMVECTOR r;
     DirectX::XMVECTOR t;
     if (!DirectX::XMMatrixDecompose(&s, &r, &t, m)) {
       return false;
     }
-    DirectX::XMStoreFloat3((DirectX::XMFLOAT3 *)&Shape, s);
-    DirectX::XMStoreFloat4((DirectX::XMFLOAT4 *)&Transform.Rotation, r);
-    DirectX::XMStoreFloat3((DirectX::XMFLOAT3 *)&Transform.Translation, t);
-    return true;
+    DirectX::XMStoreFloat3(&Scales[i], s);
+    return Hierarchy.SetWorldMatrix(
+        i, DirectX::XMMatrixRotationQuaternion(r) *
+               DirectX::XMMatrixTranslationFromVector(t));
   }
 };
 
+struct Object {
+  // row in Scene::Transforms
+  uint32_t Index;
+  rectray::Handle Handle;
+};
+
+// picked against its triangles. not selectable
+struct MeshInstance {
+  std::shared_ptr<const rectray::TriangleMesh> Mesh;
+  DirectX::XMFLOAT4X4 Matrix;
+  rectray::Handle Handle;
+};
+
 struct Scene {
+  TransformStore Transforms;
+  // rows parallel to Transforms
   std::vector<std::shared_ptr<Object>> Objects;
+  std::vector<rectray::Handle> Handles;
+  // pool tags. a handle of one pool does not resolve in another
+  static constexpr uint32_t OBJECT_TAG = 1;
+  static constexpr uint32_t MESH_TAG = 2;
+
+  // gizmo handle to object
+  rectray::HandlePool<std::shared_ptr<Object>> Pool{OBJECT_TAG};
   std::shared_ptr<Object> Selected;
+  bool VertexSnap = false;
+
+  bool SurfaceDrag = false;
+
+  // a name label on each cube
+  bool Labels = false;
+
+  // the mesh spans point into these
+  std::vector<DirectX::XMFLOAT3> SphereVertices;
+  std::vector<uint32_t> SphereIndices;
+  std::shared_ptr<const rectray::TriangleMesh> Sphere;
+  std::vector<MeshInstance> Meshes;
+  rectray::HandlePool<uint32_t> MeshPool{MESH_TAG};
+  bool MeshWireframe = false;
+
+  // point handles, drawn by Gui::Points
+  std::vector<DirectX::XMFLOAT3> Points;
+  // index in Points
+  std::optional<uint32_t> SelectedPoint;
+
+  // SnapTargets() cache
+  std::shared_ptr<const rectray::KdTree> SnapTree;
+  uint64_t SnapVersion = UINT64_MAX;
+  std::shared_ptr<Object> SnapExclude;
+
+  // SurfaceQuery() cache
+  struct SurfaceScene {
+    rectray::Bvh Bvh;
+    // bvh index to matrix
+    std::vector<DirectX::XMFLOAT4X4> Matrices;
+  };
+  std::shared_ptr<const SurfaceScene> Surface;
+  uint64_t SurfaceVersion = UINT64_MAX;
+  std::shared_ptr<Object> SurfaceExclude;
+
+  // the selected object and its descendants. they move with the drag
+  std::vector<uint8_t> SelectedSubtree() const {
+    auto &hierarchy = Transforms.Hierarchy;
+    std::vector<uint8_t> subtree(Objects.size());
+    for (uint32_t i = 0; i < Objects.size(); ++i) {
+      auto parent = hierarchy.Parent(i);
+      subtree[i] = Objects[i] == Selected ||
+                   (parent != rectray::TransformHierarchy::ROOT &&
+                    subtree[parent]);
+    }
+    return subtree;
+  }
+
+  // the other cubes in a bvh. rebuilt when the transforms or the selection
+  // changed, so a drag queries in O(log n).
+  rectray::SurfaceQuery SurfaceQuery() {
+    if (!Surface || SurfaceVersion != Transforms.Version ||
+        SurfaceExclude != Selected) {
+      auto exclude = SelectedSubtree();
+      auto scene = std::make_shared<SurfaceScene>();
+      std::vector<rectray::Aabb> boxes;
+      for (uint32_t i = 0; i < Objects.size(); ++i) {
+        if (!exclude[i]) {
+          scene->Matrices.push_back(Transforms.Matrices[i]);
+          boxes.push_back(rectray::CubeBounds(Transforms.Matrices[i]));
+        }
+      }
+      scene->Bvh = rectray::Bvh(boxes);
+      Surface = scene;
+      SurfaceVersion = Transforms.Version;
+      SurfaceExclude = Selected;
+    }
+    return [scene = Surface](const rectray::Ray &ray)
+               -> std::optional<rectray::SurfaceHit> {
+      DirectX::XMFLOAT3 normal;
+      auto hit = scene->Bvh.Raycast(
+          ray, [&scene](uint32_t i, const rectray::Ray &ray) {
+            return rectray::IntersectsCube(ray, scene->Matrices[i], nullptr);
+          });
+      if (!hit) {
+        return std::nullopt;
+      }
+      rectray::IntersectsCube(ray, scene->Matrices[hit->Index], &normal);
+      return rectray::SurfaceHit{ray.Point(hit->Distance), normal};
+    };
+  }
+
+  // cube corners except the selected subtree, which moves with the drag.
+  // rebuilt when the transforms or the selection changed.
+  std::shared_ptr<const rectray::KdTree> SnapTargets() {
+    if (SnapTree && SnapVersion == Transforms.Version &&
+        SnapExclude == Selected) {
+      return SnapTree;
+    }
+    auto exclude = SelectedSubtree();
+    std::vector<DirectX::XMFLOAT3> corners;
+    corners.reserve(Objects.size() * 8);
+    for (uint32_t i = 0; i < Objects.size(); ++i) {
+      if (exclude[i]) {
+        continue;
+      }
+      auto m = DirectX::XMLoadFloat4x4(&Transforms.Matrices[i]);
+      for (int c = 0; c < 8; ++c) {
+        DirectX::XMFLOAT3 p{c & 1 ? 0.5f : -0.5f, c & 2 ? 0.5f : -0.5f,
+                            c & 4 ? 0.5f : -0.5f};
+        DirectX::XMStoreFloat3(
+            &p, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&p), m));
+        corners.push_back(p);
+      }
+    }
+    SnapTree = std::make_shared<rectray::KdTree>(corners);
+    SnapVersion = Transforms.Version;
+    SnapExclude = Selected;
+    return SnapTree;
+  }
+
+  // position is relative to the parent. nullptr when the pool is full
+  std::shared_ptr<Object> Add(const DirectX::XMFLOAT3 &position,
+                              const std::shared_ptr<Object> &parent = {}) {
+    auto handle = Pool.Create({});
+    if (!handle) {
+      return {};
+    }
+    auto o = std::make_shared<Object>(Transforms.Add(
+        position, parent ? static_cast<int32_t>(parent->Index)
+                         : rectray::TransformHierarchy::ROOT));
+    o->Handle = handle;
+    *Pool.Resolve(handle) = o;
+    Objects.push_back(o);
+    Handles.push_back(o->Handle);
+    return o;
+  }
+
+  // uv sphere of radius 1. the mesh is built once and shared
+  void AddSphere(const DirectX::XMFLOAT3 &position, uint32_t segments = 64) {
+    if (!Sphere) {
+      auto rings = segments / 2;
+      for (uint32_t r = 0; r <= rings; ++r) {
+        auto phi = DirectX::XM_PI * r / rings;
+        for (uint32_t s = 0; s <= segments; ++s) {
+          auto theta = DirectX::XM_2PI * s / segments;
+          SphereVertices.push_back({std::sin(phi) * std::cos(theta),
+                                    std::cos(phi),
+                                    std::sin(phi) * std::sin(theta)});
+        }
+      }
+      for (uint32_t r = 0; r < rings; ++r) {
+        for (uint32_t s = 0; s < segments; ++s) {
+          auto i0 = r * (segments + 1) + s;
+          auto i1 = i0 + segments + 1;
+          SphereIndices.insert(SphereIndices.end(),
+                               {i0, i1, i0 + 1, i0 + 1, i1, i1 + 1});
+        }
+      }
+      Sphere = rectray::TriangleMesh::Create(SphereVertices, SphereIndices);
+    }
+    MeshInstance instance{Sphere};
+    DirectX::XMStoreFloat4x4(
+        &instance.Matrix,
+        DirectX::XMMatrixTranslation(position.x, position.y, position.z));
+    instance.Handle = MeshPool.Create(static_cast<uint32_t>(Meshes.size()));
+    if (!instance.Handle) {
+      // the pool is full
+      return;
+    }
+    Meshes.push_back(instance);
+  }
+
+  // a noisy sphere shell of radius 4, like a scan
+  void AddPoints(size_t count) {
+    std::mt19937 rng(static_cast<uint32_t>(Points.size()));
+    std::normal_distribution<float> normal;
+    Points.reserve(Points.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+      DirectX::XMFLOAT3 p{normal(rng), normal(rng), normal(rng)};
+      auto r = (4.0f + normal(rng) * 0.05f) / rectray::Length(p);
+      Points.push_back({p.x * r, p.y * r, p.z * r});
+    }
+  }
+
+  // nullptr for a removed object
+  std::shared_ptr<Object> Resolve(rectray::Handle handle) const {
+    if (auto o = Pool.Resolve(handle)) {
+      return *o;
+    }
+    return {};
+  }
+
+  // false for an object with children
+  bool Remove(const std::shared_ptr<Object> &o) {
+    auto i = o->Index;
+    if (!Transforms.Remove(i)) {
+      return false;
+    }
+    Pool.Release(o->Handle);
+    Objects.erase(Objects.begin() + i);
+    Handles.erase(Handles.begin() + i);
+    for (auto j = i; j < Objects.size(); ++j) {
+      Objects[j]->Index = j;
+    }
+    if (Selected == o) {
+      Selected = {};
+    }
+    return true;
+  }
 };
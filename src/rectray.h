@@ -1,5 +1,19 @@
 #pragma once
 
+#include "rectray/bvh.h"
 #include "rectray/camera.h"
+#include "rectray/compact.h"
 #include "rectray/drawlist.h"
 #include "rectray/gui.h"
+#include "rectray/handle.h"
+#include "rectray/hierarchy.h"
+#include "rectray/hiz.h"
+#include "rectray/input.h"
+#include "rectray/kdtree.h"
+#include "rectray/kernels.h"
+#include "rectray/labels.h"
+#include "rectray/mesh.h"
+#include "rectray/parallel.h"
+#include "rectray/pipeline.h"
+#include "rectray/strings.h"
+#include "rectray/tessellate.h"
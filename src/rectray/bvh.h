@@ -0,0 +1,218 @@
+#pragma once
+#include "linearalgebra.h"
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace rectray {
+
+struct Aabb {
+  DirectX::XMFLOAT3 Min{std::numeric_limits<float>::infinity(),
+                        std::numeric_limits<float>::infinity(),
+                        std::numeric_limits<float>::infinity()};
+  DirectX::XMFLOAT3 Max{-std::numeric_limits<float>::infinity(),
+                        -std::numeric_limits<float>::infinity(),
+                        -std::numeric_limits<float>::infinity()};
+
+  void Extend(const DirectX::XMFLOAT3 &p) {
+    Min = {std::min(Min.x, p.x), std::min(Min.y, p.y), std::min(Min.z, p.z)};
+    Max = {std::max(Max.x, p.x), std::max(Max.y, p.y), std::max(Max.z, p.z)};
+  }
+  void Extend(const Aabb &b) {
+    Extend(b.Min);
+    Extend(b.Max);
+  }
+  DirectX::XMFLOAT3 Center() const { return (Min + Max) * 0.5f; }
+};
+
+// the unit cube [-0.5, 0.5] transformed by m
+inline Aabb CubeBounds(const DirectX::XMFLOAT4X4 &m) {
+  DirectX::XMFLOAT3 half{
+      0.5f * (std::abs(m._11) + std::abs(m._21) + std::abs(m._31)),
+      0.5f * (std::abs(m._12) + std::abs(m._22) + std::abs(m._32)),
+      0.5f * (std::abs(m._13) + std::abs(m._23) + std::abs(m._33)),
+  };
+  auto c = MatrixPosition(m);
+  return {c - half, c + half};
+}
+
+//
+// Bounding volume hierarchy over boxes. Built once, queried by ray.
+//
+// * top down, median split on the longest axis of the centers
+// * the split is rounded to the leaf size. leaves start at a multiple of it
+//   and only the last one is partial, so a leaf maps to one packet of
+//   kernel::TrianglePacket
+// * depth first layout. the left child follows its parent
+// * Raycast visits near children first and skips nodes beyond the closest
+//   hit, so only a few leaves reach the exact test
+//
+class Bvh {
+public:
+  static const uint32_t LEAF_SIZE = 4;
+
+  struct Hit {
+    // in the source boxes
+    uint32_t Index;
+    float Distance;
+  };
+
+private:
+  struct Node {
+    Aabb Bounds;
+    // leaf: first of m_indices. inner: right child
+    uint32_t Offset;
+    // 0 for inner
+    uint32_t Count;
+  };
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_indices;
+  uint32_t m_leafSize = LEAF_SIZE;
+
+  uint32_t Build(std::span<const Aabb> boxes,
+                 std::span<const DirectX::XMFLOAT3> centers, uint32_t begin,
+                 uint32_t end) {
+    auto index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({});
+    Aabb bounds;
+    Aabb centerBounds;
+    for (auto i = begin; i < end; ++i) {
+      bounds.Extend(boxes[m_indices[i]]);
+      centerBounds.Extend(centers[m_indices[i]]);
+    }
+    if (end - begin <= m_leafSize) {
+      m_nodes[index] = {bounds, begin, end - begin};
+      return index;
+    }
+
+    auto e = centerBounds.Max - centerBounds.Min;
+    int axis = e.x >= e.y && e.x >= e.z ? 0 : (e.y >= e.z ? 1 : 2);
+    auto half = (end - begin) / 2;
+    auto mid = begin + (half + m_leafSize - 1) / m_leafSize * m_leafSize;
+    std::nth_element(m_indices.begin() + begin, m_indices.begin() + mid,
+                     m_indices.begin() + end, [&](uint32_t a, uint32_t b) {
+                       return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+                     });
+    Build(boxes, centers, begin, mid);
+    auto right = Build(boxes, centers, mid, end);
+    m_nodes[index] = {bounds, right, 0};
+    return index;
+  }
+
+  // entry distance or +inf
+  static float Slab(const Aabb &b, const DirectX::XMFLOAT3 &origin,
+                    const DirectX::XMFLOAT3 &invDir, float tMax) {
+    auto tx0 = (b.Min.x - origin.x) * invDir.x;
+    auto tx1 = (b.Max.x - origin.x) * invDir.x;
+    auto ty0 = (b.Min.y - origin.y) * invDir.y;
+    auto ty1 = (b.Max.y - origin.y) * invDir.y;
+    auto tz0 = (b.Min.z - origin.z) * invDir.z;
+    auto tz1 = (b.Max.z - origin.z) * invDir.z;
+    auto tNear = std::max({std::min(tx0, tx1), std::min(ty0, ty1),
+                           std::min(tz0, tz1), 0.0f});
+    auto tFar = std::min({std::max(tx0, tx1), std::max(ty0, ty1),
+                          std::max(tz0, tz1), tMax});
+    return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+  }
+
+public:
+  Bvh() = default;
+  explicit Bvh(std::span<const Aabb> boxes, uint32_t leafSize = LEAF_SIZE)
+      : m_leafSize(leafSize) {
+    assert(leafSize > 0);
+    auto size = static_cast<uint32_t>(boxes.size());
+    if (size == 0) {
+      return;
+    }
+    std::vector<DirectX::XMFLOAT3> centers(size);
+    m_indices.resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      centers[i] = boxes[i].Center();
+      m_indices[i] = i;
+    }
+    m_nodes.reserve(size / m_leafSize * 2 + 1);
+    Build(boxes, centers, 0, size);
+  }
+
+  size_t Size() const { return m_indices.size(); }
+  size_t NodeCount() const { return m_nodes.size(); }
+  uint32_t LeafSize() const { return m_leafSize; }
+  // source indices in leaf order
+  std::span<const uint32_t> Indices() const { return m_indices; }
+
+  // closest exact hit. test(index, ray) -> std::optional<float>
+  template <typename F>
+  std::optional<Hit>
+  Raycast(const Ray &ray, F &&test,
+          float tMax = std::numeric_limits<float>::infinity()) const {
+    return RaycastLeaves(
+        ray,
+        [this, &test](uint32_t begin, uint32_t count, const Ray &ray,
+                      float closest) -> std::optional<Hit> {
+          std::optional<Hit> hit;
+          for (auto i = begin; i < begin + count; ++i) {
+            auto index = m_indices[i];
+            if (auto t = test(index, ray); t && *t < closest) {
+              closest = *t;
+              hit = Hit{index, *t};
+            }
+          }
+          return hit;
+        },
+        tMax);
+  }
+
+  // a whole leaf at once.
+  // test(begin, count, ray, closest) -> std::optional<Hit> closer than
+  // closest. [begin, begin + count) is a range of Indices()
+  template <typename F>
+  std::optional<Hit>
+  RaycastLeaves(const Ray &ray, F &&test,
+                float tMax = std::numeric_limits<float>::infinity()) const {
+    if (m_nodes.empty()) {
+      return std::nullopt;
+    }
+    DirectX::XMFLOAT3 invDir{1.0f / ray.Direction.x, 1.0f / ray.Direction.y,
+                             1.0f / ray.Direction.z};
+    std::optional<Hit> hit;
+    auto closest = tMax;
+
+    uint32_t stack[64];
+    int top = 0;
+    if (Slab(m_nodes[0].Bounds, ray.Origin, invDir, closest) < closest) {
+      stack[top++] = 0;
+    }
+    while (top > 0) {
+      auto &node = m_nodes[stack[--top]];
+      if (node.Count) {
+        if (auto h = test(node.Offset, node.Count, ray, closest);
+            h && h->Distance < closest) {
+          closest = h->Distance;
+          hit = h;
+        }
+        continue;
+      }
+      auto left = static_cast<uint32_t>(&node - m_nodes.data()) + 1;
+      auto right = node.Offset;
+      auto tl = Slab(m_nodes[left].Bounds, ray.Origin, invDir, closest);
+      auto tr = Slab(m_nodes[right].Bounds, ray.Origin, invDir, closest);
+      // far first, near on top
+      if (tl > tr) {
+        std::swap(tl, tr);
+        std::swap(left, right);
+      }
+      if (tr < closest) {
+        stack[top++] = right;
+      }
+      if (tl < closest) {
+        stack[top++] = left;
+      }
+    }
+    return hit;
+  }
+};
+
+} // namespace rectray
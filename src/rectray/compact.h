@@ -0,0 +1,365 @@
+#pragma once
+#include "drawlist.h"
+#include <algorithm>
+#include <span>
+#include <vector>
+
+namespace rectray {
+
+namespace marker {
+
+// 8 bytes per vertex. a XMFLOAT2 position alone is 8 bytes.
+struct CompactVertex {
+  // fixed point viewport coordinate. origin is the viewport top left.
+  int16_t X;
+  int16_t Y;
+  uint32_t Color;
+};
+static_assert(sizeof(CompactVertex) == 8);
+
+// finest fixed point, 13.3. +-4096 pixels at 1/8 pixel. a wider viewport
+// trades subpixel bits for range, down to 16.0. see CompactMarkers::Build
+inline const int COMPACT_SUBPIXEL_BITS = 3;
+
+inline int16_t ToFixed(float v, float scale) {
+  v = std::clamp(v * scale, -32768.0f, 32767.0f);
+  return static_cast<int16_t>(std::lround(v));
+}
+
+inline float FromFixed(int16_t v, float scale) { return v / scale; }
+
+inline int CircleSegments(float radius, int segments) {
+  if (segments > 0) {
+    return segments;
+  }
+  // about 4 pixels per segment
+  auto auto_segments = static_cast<int>(std::ceil(
+      2 * static_cast<float>(std::numbers::pi) * radius / 4.0f));
+  return std::clamp(auto_segments, 8, 64);
+}
+
+// cos and sin of each step around the unit circle, one table per segment
+// count. built on first use and kept
+class UnitCircles {
+  std::vector<std::vector<DirectX::XMFLOAT2>> m_tables;
+
+public:
+  const std::vector<DirectX::XMFLOAT2> &Get(int segments) {
+    if (m_tables.size() <= static_cast<size_t>(segments)) {
+      m_tables.resize(segments + 1);
+    }
+    auto &table = m_tables[segments];
+    if (table.empty()) {
+      table.resize(segments);
+      auto step = 2 * static_cast<float>(std::numbers::pi) / segments;
+      for (int i = 0; i < segments; ++i) {
+        table[i] = {std::cos(step * i), std::sin(step * i)};
+      }
+    }
+    return table;
+  }
+
+  // a table Get() has built
+  const std::vector<DirectX::XMFLOAT2> &operator[](int segments) const {
+    return m_tables[segments];
+  }
+};
+
+// clip a to b by the fixed point range, +-range (Liang-Barsky).
+// false if nothing is left.
+inline bool ClipToCompactRange(DirectX::XMFLOAT2 *a, DirectX::XMFLOAT2 *b,
+                               float range) {
+  float t0 = 0;
+  float t1 = 1;
+  auto d = *b - *a;
+  float p[] = {-d.x, d.x, -d.y, d.y};
+  float q[] = {a->x + range, range - a->x, a->y + range, range - a->y};
+  for (int i = 0; i < 4; ++i) {
+    if (p[i] == 0) {
+      if (q[i] < 0) {
+        return false;
+      }
+      continue;
+    }
+    auto r = q[i] / p[i];
+    if (p[i] < 0) {
+      t0 = std::max(t0, r);
+    } else {
+      t1 = std::min(t1, r);
+    }
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  auto start = *a;
+  *a = start + d * t0;
+  *b = start + d * t1;
+  return true;
+}
+
+// clip the convex polygon in to +-range on both axes (Sutherland-Hodgman).
+// the result is convex, empty if nothing is left
+inline void ClipToCompactRange(std::span<const DirectX::XMFLOAT2> in,
+                               float range,
+                               std::vector<DirectX::XMFLOAT2> *out,
+                               std::vector<DirectX::XMFLOAT2> *scratch) {
+  out->assign(in.begin(), in.end());
+  // x >= -range, x <= range, y >= -range, y <= range
+  for (int edge = 0; edge < 4 && !out->empty(); ++edge) {
+    auto axis = edge / 2;
+    auto sign = edge % 2 ? -1.0f : 1.0f;
+    // >= 0 inside
+    auto inside = [&](const DirectX::XMFLOAT2 &p) {
+      return sign * (axis ? p.y : p.x) + range;
+    };
+    std::swap(*out, *scratch);
+    out->clear();
+    auto &points = *scratch;
+    for (size_t i = 0; i < points.size(); ++i) {
+      auto &a = points[i];
+      auto &b = points[(i + 1) % points.size()];
+      auto da = inside(a);
+      auto db = inside(b);
+      if (da >= 0) {
+        out->push_back(a);
+      }
+      if ((da >= 0) != (db >= 0)) {
+        out->push_back(a + (b - a) * (da / (da - db)));
+      }
+    }
+  }
+}
+
+// consecutive lines with the same thickness
+struct CompactLineBatch {
+  float Thickness;
+  uint32_t IndexOffset;
+  uint32_t IndexCount;
+};
+
+//
+// Markers packed for direct upload.
+//
+// * line list and triangle list share one vertex buffer
+// * indices are 16 bit until the vertex count exceeds 65536, then 32 bit
+// * the fixed point range is +-32767 / Scale() pixels around the viewport
+//   top left. Build() picks the finest scale that holds twice the viewport,
+//   1/8 pixel up to 2048 pixels and whole pixels up to 16383. a viewport
+//   wider than that loses its far side
+// * lines and polygons are clipped to the range, not clamped
+// * text is not packed. TextMarkers keeps the index in the source markers
+//
+// shader: position = viewport_origin + vec2(X, Y) / Scale()
+//
+class CompactMarkers {
+  std::vector<CompactVertex> m_vertices;
+  std::vector<CompactLineBatch> m_lineBatches;
+  std::vector<uint32_t> m_textMarkers;
+  std::vector<uint16_t> m_lines16;
+  std::vector<uint16_t> m_triangles16;
+  std::vector<uint32_t> m_lines32;
+  std::vector<uint32_t> m_triangles32;
+  bool m_index32 = false;
+  // circles
+  UnitCircles m_circles;
+  std::vector<DirectX::XMFLOAT2> m_circlePoints;
+  // fans clipped to the range
+  std::vector<DirectX::XMFLOAT2> m_clipped;
+  std::vector<DirectX::XMFLOAT2> m_clipScratch;
+  // fixed point units per pixel and the pixels that fit
+  float m_scale = 1 << COMPACT_SUBPIXEL_BITS;
+  float m_range = 32767 / m_scale;
+
+  uint32_t AddVertex(const DirectX::XMFLOAT2 &p, uint32_t color) {
+    auto index = static_cast<uint32_t>(m_vertices.size());
+    if (!m_index32 && index > 0xFFFF) {
+      // widen once
+      m_lines32.assign(m_lines16.begin(), m_lines16.end());
+      m_triangles32.assign(m_triangles16.begin(), m_triangles16.end());
+      m_lines16.clear();
+      m_triangles16.clear();
+      m_index32 = true;
+    }
+    m_vertices.push_back({ToFixed(p.x, m_scale), ToFixed(p.y, m_scale), color});
+    return index;
+  }
+
+  void PushIndex(bool line, uint32_t index) {
+    if (m_index32) {
+      (line ? m_lines32 : m_triangles32).push_back(index);
+    } else {
+      (line ? m_lines16 : m_triangles16)
+          .push_back(static_cast<uint16_t>(index));
+    }
+  }
+
+  void AddLine(DirectX::XMFLOAT2 a, DirectX::XMFLOAT2 b, uint32_t color,
+               float thickness) {
+    if (!ClipToCompactRange(&a, &b, m_range)) {
+      return;
+    }
+    auto i0 = AddVertex(a, color);
+    auto i1 = AddVertex(b, color);
+    auto offset = static_cast<uint32_t>(LineIndexCount());
+    PushIndex(true, i0);
+    PushIndex(true, i1);
+    if (m_lineBatches.empty() || m_lineBatches.back().Thickness != thickness) {
+      m_lineBatches.push_back({thickness, offset, 0});
+    }
+    m_lineBatches.back().IndexCount += 2;
+  }
+
+  // convex fan
+  void AddFan(std::span<const DirectX::XMFLOAT2> points, uint32_t color) {
+    if (points.size() < 3) {
+      return;
+    }
+    auto outside = [range = m_range](const DirectX::XMFLOAT2 &p) {
+      return p.x < -range || p.x > range || p.y < -range || p.y > range;
+    };
+    if (std::any_of(points.begin(), points.end(), outside)) {
+      ClipToCompactRange(points, m_range, &m_clipped, &m_clipScratch);
+      if (m_clipped.size() < 3) {
+        return;
+      }
+      points = m_clipped;
+    }
+    auto first = AddVertex(points[0], color);
+    auto prev = AddVertex(points[1], color);
+    for (size_t i = 2; i < points.size(); ++i) {
+      auto current = AddVertex(points[i], color);
+      PushIndex(false, first);
+      PushIndex(false, prev);
+      PushIndex(false, current);
+      prev = current;
+    }
+  }
+
+  void AddLoop(std::span<const DirectX::XMFLOAT2> points, bool closed,
+               uint32_t color, float thickness) {
+    for (size_t i = 1; i < points.size(); ++i) {
+      AddLine(points[i - 1], points[i], color, thickness);
+    }
+    if (closed && points.size() > 2) {
+      AddLine(points.back(), points.front(), color, thickness);
+    }
+  }
+
+public:
+  const std::vector<CompactVertex> &Vertices() const { return m_vertices; }
+  const std::vector<CompactLineBatch> &LineBatches() const {
+    return m_lineBatches;
+  }
+  const std::vector<uint32_t> &TextMarkers() const { return m_textMarkers; }
+  // fixed point units per pixel of the last Build()
+  float Scale() const { return m_scale; }
+
+  // 2 or 4
+  uint32_t IndexSize() const { return m_index32 ? 4 : 2; }
+  size_t LineIndexCount() const {
+    return m_index32 ? m_lines32.size() : m_lines16.size();
+  }
+  size_t TriangleIndexCount() const {
+    return m_index32 ? m_triangles32.size() : m_triangles16.size();
+  }
+  // IndexSize() bytes per index
+  const void *LineIndices() const {
+    return m_index32 ? (const void *)m_lines32.data()
+                     : (const void *)m_lines16.data();
+  }
+  const void *TriangleIndices() const {
+    return m_index32 ? (const void *)m_triangles32.data()
+                     : (const void *)m_triangles16.data();
+  }
+
+  void Clear() {
+    m_vertices.clear();
+    m_lineBatches.clear();
+    m_textMarkers.clear();
+    m_lines16.clear();
+    m_triangles16.clear();
+    m_lines32.clear();
+    m_triangles32.clear();
+    m_index32 = false;
+  }
+
+  // extent is the larger viewport side in pixels. 0 keeps the finest scale
+  void Build(std::span<const Command> markers, float extent = 0) {
+    Clear();
+    auto bits = COMPACT_SUBPIXEL_BITS;
+    while (bits > 0 && 32767.0f / (1 << bits) < 2 * extent) {
+      --bits;
+    }
+    m_scale = static_cast<float>(1 << bits);
+    m_range = 32767 / m_scale;
+
+    struct Visitor {
+      CompactMarkers *Self;
+      const Command &Marker;
+      uint32_t Index;
+
+      void operator()(const Line &shape) {
+        Self->AddLine(shape.P0, shape.P1, Marker.Color,
+                      Marker.Thickness.value_or(1.0f));
+      }
+      void operator()(const Triangle &shape) {
+        DirectX::XMFLOAT2 points[] = {shape.P0, shape.P1, shape.P2};
+        if (Marker.Thickness) {
+          Self->AddLoop(points, true, Marker.Color, *Marker.Thickness);
+        } else {
+          Self->AddFan(points, Marker.Color);
+        }
+      }
+      void operator()(const Circle &shape) {
+        auto &unit = Self->m_circles.Get(
+            CircleSegments(shape.Radius, shape.Segments));
+        auto &points = Self->m_circlePoints;
+        points.resize(unit.size());
+        for (size_t i = 0; i < unit.size(); ++i) {
+          points[i] = {shape.Center.x + unit[i].x * shape.Radius,
+                       shape.Center.y + unit[i].y * shape.Radius};
+        }
+        if (Marker.Thickness) {
+          Self->AddLoop(points, true, Marker.Color, *Marker.Thickness);
+        } else {
+          Self->AddFan(points, Marker.Color);
+        }
+      }
+      void operator()(const Polyline &shape) {
+        if (Marker.Thickness) {
+          Self->AddLoop(shape.Points, shape.Flags & 1, Marker.Color,
+                        *Marker.Thickness);
+        } else {
+          Self->AddFan(shape.Points, Marker.Color);
+        }
+      }
+      void operator()(const Points &shape) {
+        auto r = shape.Radius;
+        for (auto &c : shape.Centers) {
+          DirectX::XMFLOAT2 quad[] = {
+              {c.x - r, c.y - r},
+              {c.x + r, c.y - r},
+              {c.x + r, c.y + r},
+              {c.x - r, c.y + r},
+          };
+          Self->AddFan(quad, Marker.Color);
+        }
+      }
+      void operator()(const Lines &shape) {
+        for (size_t i = 1; i < shape.Points.size(); i += 2) {
+          Self->AddLine(shape.Points[i - 1], shape.Points[i], Marker.Color,
+                        Marker.Thickness.value_or(1.0f));
+        }
+      }
+      void operator()(const Text &) { Self->m_textMarkers.push_back(Index); }
+    };
+
+    for (uint32_t i = 0; i < markers.size(); ++i) {
+      std::visit(Visitor{this, markers[i], i}, markers[i].Shape);
+    }
+  }
+};
+
+} // namespace marker
+
+} // namespace rectray
@@ -1,6 +1,7 @@
 #pragma once
 #include "camera.h"
 #include "intersects.h"
+#include "kernels.h"
 #include <functional>
 #include <optional>
 
@@ -21,9 +22,13 @@ struct Context {
     }
   }
 
-  float PixelToLength(uint32_t pixel, const DirectX::XMFLOAT3 &world) {
-    // TODO:
-    return 0.1f;
+  // another mouse sample within the frame. viewport coordinates
+  void SetMouse(float x, float y) {
+    Viewport.MouseX = x;
+    Viewport.MouseY = y;
+    if (Viewport.Focus != ViewportFocus::None) {
+      Ray = Camera.GetRay(Viewport);
+    }
   }
 
   DirectX::XMFLOAT2 WorldToViewport(const DirectX::XMFLOAT3 &v) const {
@@ -38,51 +43,37 @@ struct Context {
     return WorldToViewport(*((const DirectX::XMFLOAT3 *)&m.m[3]));
   }
 
+  // world length of a pixel at ray distance 1 around the cursor.
+  // pixels * rayT * RayPixelScale() is the tolerance at ray distance rayT
+  float RayPixelScale() const {
+    if (!Ray) {
+      return 0;
+    }
+    DirectX::XMFLOAT3 forward;
+    DirectX::XMStoreFloat3(
+        &forward, DirectX::XMVector3Rotate(
+                      DirectX::XMVectorSet(0, 0, -1, 0),
+                      DirectX::XMLoadFloat4(&Camera.Transform.Rotation)));
+    return Dot(Ray->Direction, forward) * 2 *
+           std::tan(Camera.Projection.FovY * 0.5f) / Viewport.ViewportHeight;
+  }
+
+  // ray distance where the ray passes within pixel of the segment s-e
   std::optional<float> Intersects(const DirectX::XMFLOAT3 &s,
-                                  const DirectX::XMFLOAT3 &e, uint32_t pixel) {
+                                  const DirectX::XMFLOAT3 &e,
+                                  uint32_t pixel) const {
     if (!Ray) {
       return {};
     }
-    // return LessDistance(s, e, PixelToLength(pixel, s));
-    auto c0 = WorldToViewport(s);
-    auto c1 = WorldToViewport(e);
-    auto c = Viewport.Intersects(c0, c1, pixel);
-    if (!c) {
+    float pixels = static_cast<float>(pixel);
+    float hit;
+    kernel::IntersectsSegments(*Ray, {&s, 1}, {&e, 1}, {&pixels, 1},
+                               RayPixelScale(), {&hit, 1});
+    if (hit == std::numeric_limits<float>::infinity()) {
       return {};
     }
-    auto w = s + (e - s) * (Length(*c - c0) / Length(c1 - c0));
-    return Length(Camera.Transform.Translation - w);
+    return hit;
   }
-
-  // std::optional<float> LessDistance(const DirectX::XMFLOAT3 &q0,
-  //                                   const DirectX::XMFLOAT3 &q1,
-  //                                   float distance) {
-  //   if (!Ray) {
-  //     return {};
-  //   }
-  //   auto &p0 = Ray->Origin;
-  //   auto &pv = Ray->Direction;
-  //   auto qv = Normalized(q1 - q0);
-  //
-  //   auto pv2 = Dot(pv, pv);
-  //   auto qv2 = Dot(qv, qv);
-  //   auto vpq = Dot(pv, qv);
-  //
-  //   auto dot0 = Dot((q0 - p0), pv);
-  //   auto dot1 = Dot((p0 - q0), qv);
-  //
-  //   auto f = 1 / (pv2 * qv2 - vpq * vpq);
-  //   auto s = f * qv2 * dot0 + vpq * dot1;
-  //   auto t = f * vpq * dot0 + pv2 * dot1;
-  //
-  //   auto c0 = p0 + pv * s;
-  //   auto c1 = q0 + qv * t;
-  //   auto d = Length(c0 - c1);
-  //   if (d > distance) {
-  //     return {};
-  //   }
-  //   return s;
-  // }
 };
 
 } // namespace rectray
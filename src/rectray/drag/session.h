@@ -0,0 +1,183 @@
+#pragma once
+#include <DirectXMath.h>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+namespace rectray {
+
+//
+// Fixed storage for drag coroutine frames, so a session does not touch the
+// heap.
+//
+// * SLOTS blocks of SLOT_SIZE bytes. a frame that does not fit, or one more
+//   than SLOTS, goes to the heap and is counted in HeapFallbacks
+// * each block starts with a header naming its pool, so the frame is
+//   returned to the right place
+// * single threaded. one per Gui
+//
+class FramePool {
+public:
+  static const size_t SLOT_SIZE = 2048;
+  static const uint32_t SLOTS = 4;
+
+private:
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+    // nullptr for the heap
+    FramePool *Pool;
+    uint32_t Slot;
+  };
+  struct Slot {
+    alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) unsigned char
+        Bytes[sizeof(Header) + SLOT_SIZE];
+  };
+  Slot m_slots[SLOTS];
+  uint32_t m_used = 0;
+
+public:
+  // frames that did not fit
+  uint32_t HeapFallbacks = 0;
+
+  FramePool() = default;
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  void *Allocate(size_t size) {
+    if (size <= SLOT_SIZE) {
+      for (uint32_t i = 0; i < SLOTS; ++i) {
+        if (!(m_used & (1u << i))) {
+          m_used |= 1u << i;
+          auto header = new (m_slots[i].Bytes) Header{this, i};
+          return header + 1;
+        }
+      }
+    }
+    ++HeapFallbacks;
+    auto header = new (::operator new(sizeof(Header) + size)) Header{};
+    return header + 1;
+  }
+
+  static void Free(void *p) {
+    auto header = static_cast<Header *>(p) - 1;
+    if (header->Pool) {
+      header->Pool->m_used &= ~(1u << header->Slot);
+    } else {
+      ::operator delete(header);
+    }
+  }
+};
+
+// what a drag gets each frame
+struct DragFrame {
+  const struct Context *Context = nullptr;
+  DirectX::XMFLOAT4X4 *Matrix = nullptr;
+  struct DrawList *DrawList = nullptr;
+};
+
+//
+// A drag as a coroutine, resumed once a frame until it returns.
+//
+// * the coroutine takes a FramePool & as its first parameter. its frame is
+//   allocated there
+// * co_await NextFrame{} yields the DragFrame of the next Resume(). the
+//   first one does not suspend, so the body sees the first frame too
+// * nothing runs until the first Resume()
+//
+// DragSession Example(FramePool &, Translation t) {
+//   while (true) {
+//     auto &frame = co_await NextFrame{};
+//     if (!frame.Context->Viewport.MouseLeftDown) {
+//       co_return;
+//     }
+//     t(*frame.Context, frame.Matrix, *frame.DrawList);
+//   }
+// }
+//
+class DragSession {
+public:
+  struct promise_type {
+    DragFrame Frame;
+    // Frame is not consumed by a co_await yet
+    bool Fresh = false;
+
+    template <typename... Args>
+    static void *operator new(size_t size, FramePool &pool, Args &&...) {
+      return pool.Allocate(size);
+    }
+    static void operator delete(void *p) { FramePool::Free(p); }
+
+    DragSession get_return_object() {
+      return DragSession(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+private:
+  std::coroutine_handle<promise_type> m_handle;
+  explicit DragSession(std::coroutine_handle<promise_type> handle)
+      : m_handle(handle) {}
+
+public:
+  DragSession() = default;
+  ~DragSession() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+  DragSession(DragSession &&rhs) noexcept
+      : m_handle(std::exchange(rhs.m_handle, {})) {}
+  DragSession &operator=(DragSession &&rhs) noexcept {
+    if (this != &rhs) {
+      if (m_handle) {
+        m_handle.destroy();
+      }
+      m_handle = std::exchange(rhs.m_handle, {});
+    }
+    return *this;
+  }
+  DragSession(const DragSession &) = delete;
+  DragSession &operator=(const DragSession &) = delete;
+
+  // started and not returned yet
+  explicit operator bool() const { return m_handle && !m_handle.done(); }
+
+  // runs the drag for this frame. false once it has returned
+  bool Resume(const DragFrame &frame) {
+    if (!*this) {
+      return false;
+    }
+    m_handle.promise().Frame = frame;
+    m_handle.promise().Fresh = true;
+    m_handle.resume();
+    return !m_handle.done();
+  }
+};
+
+// co_await NextFrame{} in a DragSession
+struct NextFrame {
+  DragSession::promise_type *m_promise = nullptr;
+
+  bool await_ready() const noexcept { return false; }
+  // suspends unless the frame of this Resume() is still unused
+  bool await_suspend(
+      std::coroutine_handle<DragSession::promise_type> handle) noexcept {
+    m_promise = &handle.promise();
+    return !m_promise->Fresh;
+  }
+  const DragFrame &await_resume() const noexcept {
+    m_promise->Fresh = false;
+    return m_promise->Frame;
+  }
+};
+
+using BeginSessionFunc = std::function<DragSession(FramePool &)>;
+
+} // namespace rectray
@@ -1,9 +1,22 @@
 #pragma once
 #include "../drawlist.h"
 #include "../intersects.h"
+#include "../kdtree.h"
+#include "session.h"
+#include <memory>
+#include <string.h>
 
 namespace rectray {
 
+struct SurfaceHit {
+  DirectX::XMFLOAT3 Point;
+  // outward, normalized
+  DirectX::XMFLOAT3 Normal;
+};
+
+// ray against the scene except the dragged object
+using SurfaceQuery = std::function<std::optional<SurfaceHit>(const Ray &)>;
+
 struct Translation {
   enum class DragType {
     X,
@@ -24,6 +37,14 @@ struct Translation {
   DirectX::XMFLOAT3 PlainOrigin;
   DirectX::XMFLOAT2 PlainStartViewport;
 
+  // the position snaps to the target nearest on screen within SnapPixels
+  std::shared_ptr<const KdTree> SnapTargets;
+  float SnapPixels = 8;
+
+  // DragType::SCREEN slides on the surface under the cursor. the dragged
+  // cube rests on it. off the surfaces it moves on the drag plain
+  SurfaceQuery Surface;
+
   Translation(const Context &context, const DirectX::XMFLOAT4X4 &matrix,
               DragType type)
       : Type(type) {
@@ -66,6 +87,73 @@ struct Translation {
     return DragPlainNormals[(int)type];
   }
 
+private:
+  // SnapTargets in front of the camera projected to the viewport, z = 0.
+  // a 2D query, so a target at any depth under the cursor is found
+  struct ScreenTargets {
+    DirectX::XMFLOAT4X4 ViewProjection;
+    DirectX::XMFLOAT2 Size;
+    // world position of each tree point
+    std::vector<DirectX::XMFLOAT3> World;
+    KdTree Tree;
+  };
+  std::optional<ScreenTargets> m_screenTargets;
+
+  // built on the first Snap() of the drag, again when the view changes
+  const ScreenTargets &Project(const Context &context) {
+    DirectX::XMFLOAT4X4 vp;
+    DirectX::XMStoreFloat4x4(&vp, context.Camera.ViewProjection());
+    DirectX::XMFLOAT2 size{context.Viewport.ViewportWidth,
+                           context.Viewport.ViewportHeight};
+    if (m_screenTargets &&
+        memcmp(&m_screenTargets->ViewProjection, &vp, sizeof(vp)) == 0 &&
+        m_screenTargets->Size.x == size.x &&
+        m_screenTargets->Size.y == size.y) {
+      return *m_screenTargets;
+    }
+    auto m = DirectX::XMLoadFloat4x4(&vp);
+    std::vector<DirectX::XMFLOAT3> world;
+    std::vector<DirectX::XMFLOAT3> screen;
+    for (auto &p : SnapTargets->Points()) {
+      DirectX::XMFLOAT4 c;
+      DirectX::XMStoreFloat4(
+          &c, DirectX::XMVector4Transform(
+                  DirectX::XMVectorSet(p.x, p.y, p.z, 1), m));
+      if (c.w <= 0) {
+        continue;
+      }
+      auto v = context.Viewport.ClipToViewport(c);
+      world.push_back(p);
+      screen.push_back({v.x, v.y, 0});
+    }
+    m_screenTargets = ScreenTargets{vp, size, std::move(world),
+                                    KdTree(screen)};
+    return *m_screenTargets;
+  }
+
+public:
+  // target nearest to p on screen within SnapPixels, whatever its depth
+  std::optional<DirectX::XMFLOAT3> Snap(const Context &context,
+                                        const DirectX::XMFLOAT3 &p) {
+    if (!SnapTargets) {
+      return std::nullopt;
+    }
+    DirectX::XMFLOAT4 c;
+    DirectX::XMStoreFloat4(
+        &c, DirectX::XMVector4Transform(DirectX::XMVectorSet(p.x, p.y, p.z, 1),
+                                        context.Camera.ViewProjection()));
+    if (c.w <= 0) {
+      return std::nullopt;
+    }
+    auto &targets = Project(context);
+    auto v = context.Viewport.ClipToViewport(c);
+    auto hit = targets.Tree.Nearest({v.x, v.y, 0}, SnapPixels);
+    if (!hit) {
+      return std::nullopt;
+    }
+    return targets.World[hit->Index];
+  }
+
   void operator()(const Context &context, DirectX::XMFLOAT4X4 *matrix,
                   DrawList &drawlist) {
 
@@ -73,11 +161,38 @@ struct Translation {
     drawlist.AddCircle(ModelPositionViewport, 6.f, DRAG_COLOR);
 
     if (auto ray = context.Ray) {
+      if (Type == DragType::SCREEN && Surface) {
+        if (auto hit = Surface(*ray)) {
+          // distance from the center to the cube's face along the normal
+          auto n = hit->Normal;
+          auto support = 0.5f * (std::abs(Dot(MatrixAxisX(*matrix), n)) +
+                                 std::abs(Dot(MatrixAxisY(*matrix), n)) +
+                                 std::abs(Dot(MatrixAxisZ(*matrix), n)));
+          auto position = hit->Point + n * support;
+          auto &m = matrix->m[3];
+          m[0] = position.x;
+          m[1] = position.y;
+          m[2] = position.z;
+
+          auto newPosViewport = context.WorldToViewport(position);
+          drawlist.AddLine(ModelPositionViewport, newPosViewport, DRAG_COLOR,
+                           2.0f);
+          drawlist.AddCircle(newPosViewport, 6.f, DRAG_COLOR);
+          drawlist.AddLine(newPosViewport,
+                           context.WorldToViewport(hit->Point + n), DRAG_COLOR,
+                           1.0f);
+          return;
+        }
+      }
       if (auto t = Intersects(*ray, Plain)) {
         auto newRayPos = ray->Point(*t);
 
         // compute delta
         auto newModelPos = ModelPosition + (newRayPos - PlainOrigin);
+        auto snapped = Snap(context, newModelPos);
+        if (snapped) {
+          newModelPos = *snapped;
+        }
         auto delta = newModelPos - MatrixPosition(*matrix);
 
         // 1 axis constraint
@@ -98,10 +213,25 @@ struct Translation {
           drawlist.AddLine(ModelPositionViewport, newPosViewport, DRAG_COLOR,
                            2.0f);
           drawlist.AddCircle(newPosViewport, 6.f, DRAG_COLOR);
+          if (snapped) {
+            drawlist.AddCircleFilled(context.WorldToViewport(*snapped), 4.f,
+                                     DRAG_COLOR);
+          }
         }
       }
     }
   }
 };
 
+// Translation as a DragSession. returns when the button is released
+inline DragSession TranslationSession(FramePool &, Translation translation) {
+  while (true) {
+    auto &frame = co_await NextFrame{};
+    if (!frame.Context->Viewport.MouseLeftDown) {
+      co_return;
+    }
+    translation(*frame.Context, frame.Matrix, *frame.DrawList);
+  }
+}
+
 } // namespace rectray
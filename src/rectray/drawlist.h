@@ -2,9 +2,16 @@
 #include "camera.h"
 #include "context.h"
 #include "drag/drag.h"
+#include "drag/session.h"
+#include "handle.h"
+#include "kernels.h"
+#include "mesh.h"
+#include "strings.h"
 #include <functional>
 #include <list>
 #include <memory>
+#include <span>
+#include <unordered_map>
 #include <variant>
 
 namespace rectray {
@@ -42,12 +49,29 @@ struct Arrow {
   }
 };
 
+// screen space disc at a world position
+struct Point {
+  DirectX::XMFLOAT3 P;
+  // pixels
+  float Radius;
+};
+
+// instance of a shared TriangleMesh
+struct Mesh {
+  std::shared_ptr<const TriangleMesh> Source;
+  DirectX::XMFLOAT4X4 Matrix;
+  // all edges. silhouette and open edges if false
+  bool Wireframe = false;
+};
+
 struct Command {
-  std::variant<Rect, Cube, Frustum, Arrow> Shape;
+  std::variant<Rect, Cube, Frustum, Arrow, Point, Mesh> Shape;
   uint32_t Color = 0xFFFFFFFF;
-  void *Handle = nullptr;
+  rectray::Handle Handle;
   std::optional<float> RayHit;
   std::function<DragFunc()> BeginDrag;
+  // preferred over BeginDrag
+  BeginSessionFunc BeginSession;
 };
 
 } // namespace gizmo
@@ -92,30 +116,176 @@ struct Circle {
 };
 struct Text {
   DirectX::XMFLOAT2 Pos;
-  std::string Label;
+  // in the DrawList's storage or the caller's. see DrawList::AddText
+  std::string_view Label;
 };
 struct Polyline {
-  std::vector<DirectX::XMFLOAT2> Points;
+  // in the DrawList's storage. see DrawList::PointBuffer
+  std::span<const DirectX::XMFLOAT2> Points;
   int Flags = 0;
 };
+// segments of one color and thickness, P0 P1 of each in turn.
+// see DrawList::PointBuffer
+struct Lines {
+  std::span<const DirectX::XMFLOAT2> Points;
+};
+// squares of one size and color. see DrawList::PointBuffer
+struct Points {
+  std::span<const DirectX::XMFLOAT2> Centers;
+  // half the side
+  float Radius;
+};
 
 struct Command {
-  std::variant<Line, Triangle, Circle, Polyline, Text> Shape;
+  std::variant<Line, Triangle, Circle, Polyline, Text, Points, Lines> Shape;
   uint32_t Color;
   std::optional<float> Thickness;
 };
 
+// read only markers of a finished frame
+struct View {
+  std::span<const Command> Markers;
+  // viewport position on screen. add to every point when emitting
+  DirectX::XMFLOAT2 Offset;
+
+  // visitor(const Command &, const Shape &)
+  template <typename V> void Visit(V &&visitor) const {
+    for (auto &command : Markers) {
+      std::visit([&](const auto &shape) { visitor(command, shape); },
+                 command.Shape);
+    }
+  }
+};
+
 } // namespace marker
 
+// where DrawList::AddText keeps a label
+enum class TextStorage {
+  // copied to the frame's arena
+  Frame,
+  // copied once and kept across frames. for labels that repeat
+  Interned,
+  // not copied. the caller keeps it alive until the next Clear()
+  External,
+};
+
 struct DrawList {
+  // distinct TextStorage::Interned labels kept before the ones unused for
+  // INTERNED_FRAMES frames are dropped
+  static constexpr size_t MAX_INTERNED = 4096;
+  static constexpr uint64_t INTERNED_FRAMES = 60;
+
   std::list<gizmo::Command> Gizmos;
+  // gizmo::Cube without a Command. see Gui::Cubes
+  std::vector<DirectX::XMFLOAT4X4> Cubes;
+  std::vector<uint32_t> CubeColors;
   std::vector<primitive::Command> Primitives;
   std::vector<marker::Command> Markers;
 
+private:
+  // Cubes corners, projected in one batch
+  std::vector<DirectX::XMFLOAT3> m_corners;
+  std::vector<DirectX::XMFLOAT2> m_projected;
+  std::vector<float> m_w;
+  // gizmo::Mesh edges to emit
+  std::vector<uint32_t> m_edges;
+  // silhouette edges of a gizmo::Mesh by handle, kept while the eye stays in
+  // the same place in mesh space. dropped when the mesh is not drawn
+  struct Silhouette {
+    std::shared_ptr<const TriangleMesh> Source;
+    DirectX::XMFLOAT3 Eye;
+    std::vector<uint32_t> Edges;
+    bool Used;
+  };
+  std::unordered_map<uint64_t, Silhouette> m_silhouettes;
+  // marker::Points storage. capacity is kept across frames
+  std::vector<std::vector<DirectX::XMFLOAT2>> m_pointBuffers;
+  size_t m_pointBuffersUsed = 0;
+  // marker::Text storage
+  StringArena m_textArena;
+  StringInterner m_textInterned;
+
+  void CubesToMarker(const DirectX::XMFLOAT4X4 &viewProjection,
+                     const ViewportState &screen) {
+    m_corners.resize(Cubes.size() * 8);
+    for (size_t i = 0; i < Cubes.size(); ++i) {
+      auto &m = Cubes[i];
+      auto x = MatrixAxisX(m) * 0.5f;
+      auto y = MatrixAxisY(m) * 0.5f;
+      auto z = MatrixAxisZ(m) * 0.5f;
+      auto o = MatrixPosition(m);
+      // same order as gizmo::Cube
+      auto p = &m_corners[i * 8];
+      p[0] = o - x - y + z;
+      p[1] = o + x - y + z;
+      p[2] = o + x + y + z;
+      p[3] = o - x + y + z;
+      p[4] = o - x - y - z;
+      p[5] = o + x - y - z;
+      p[6] = o + x + y - z;
+      p[7] = o - x + y - z;
+    }
+    m_projected.resize(m_corners.size());
+    m_w.resize(m_corners.size());
+    kernel::ProjectPoints(viewProjection, screen.ViewportWidth,
+                          screen.ViewportHeight, m_corners, m_projected, m_w);
+
+    const int faces[6][4] = {
+        {1, 5, 6, 2}, {2, 6, 7, 3}, {0, 1, 2, 3}, //+x+y+z
+        {4, 0, 3, 7}, {5, 1, 0, 4}, {5, 4, 7, 6}, //-x-y-z
+    };
+    // all faces in one buffer. no allocation once it has grown
+    auto points = PointBuffer(Cubes.size() * 6 * 5);
+    for (size_t i = 0; i < Cubes.size(); ++i) {
+      auto p = &m_projected[i * 8];
+      for (int f = 0; f < 6; ++f) {
+        auto &face = faces[f];
+        auto q = points.subspan((i * 6 + f) * 5, 5);
+        q[0] = p[face[0]];
+        q[1] = p[face[1]];
+        q[2] = p[face[2]];
+        q[3] = p[face[3]];
+        q[4] = p[face[0]];
+        Markers.push_back({marker::Polyline{q, 0}, CubeColors[i], 1.0f});
+      }
+    }
+  }
+
+public:
   void Clear() {
     Gizmos.clear();
+    Cubes.clear();
+    CubeColors.clear();
     Primitives.clear();
     Markers.clear();
+    m_pointBuffersUsed = 0;
+    m_textArena.Clear();
+    m_textInterned.NextFrame();
+    if (m_textInterned.Size() > MAX_INTERNED) {
+      // labels that stopped repeating. the ones in use stay
+      m_textInterned.Evict(INTERNED_FRAMES);
+    }
+  }
+
+  // count points of scratch for one marker::Points or Polyline. valid until
+  // Clear(), also when more buffers are taken. not zeroed
+  std::span<DirectX::XMFLOAT2> PointBuffer(size_t count) {
+    if (m_pointBuffersUsed == m_pointBuffers.size()) {
+      m_pointBuffers.emplace_back();
+    }
+    auto &buffer = m_pointBuffers[m_pointBuffersUsed++];
+    if (buffer.size() < count) {
+      buffer.resize(count);
+    }
+    return {buffer.data(), count};
+  }
+
+  // centers must outlive the frame. see PointBuffer()
+  void AddPoints(std::span<const DirectX::XMFLOAT2> centers, float radius,
+                 uint32_t col) {
+    if (!centers.empty()) {
+      Markers.push_back({marker::Points{centers, radius}, col});
+    }
   }
 
   void AddLine(const DirectX::XMFLOAT2 &p0, const DirectX::XMFLOAT2 &p1,
@@ -123,6 +293,14 @@ struct DrawList {
     Markers.push_back({marker::Line{p0, p1}, col, thickness});
   }
 
+  // points must outlive the frame. see PointBuffer()
+  void AddLines(std::span<const DirectX::XMFLOAT2> points, uint32_t col,
+                float thickness = 1.0f) {
+    if (points.size() >= 2) {
+      Markers.push_back({marker::Lines{points}, col, thickness});
+    }
+  }
+
   void AddTriangleFilled(const DirectX::XMFLOAT2 &p0,
                          const DirectX::XMFLOAT2 &p1,
                          const DirectX::XMFLOAT2 &p2, uint32_t col) {
@@ -140,27 +318,48 @@ struct DrawList {
     Markers.push_back({marker::Circle{center, radius, num_segments}, col});
   }
 
+  // text kept as storage says, valid until Clear()
+  std::string_view StoreText(std::string_view text, TextStorage storage) {
+    switch (storage) {
+    case TextStorage::Frame:
+      return m_textArena.Store(text);
+    case TextStorage::Interned:
+      return m_textInterned.Intern(text);
+    case TextStorage::External:
+      break;
+    }
+    return text;
+  }
+
+  // the label is valid until Clear(). see TextStorage
+  void AddText(const DirectX::XMFLOAT2 &pos, uint32_t col,
+               std::string_view text, TextStorage storage) {
+    Markers.push_back({marker::Text{pos, StoreText(text, storage)}, col});
+  }
+
   void AddText(const DirectX::XMFLOAT2 &pos, uint32_t col,
                const char *text_begin, const char *text_end = NULL) {
-    Markers.push_back(
-        {marker::Text{pos, text_end ? std::string{text_begin, text_end}
-                                    : std::string{text_begin}},
-         col});
+    auto text = text_end ? std::string_view(text_begin, text_end)
+                         : std::string_view(text_begin);
+    AddText(pos, col, text, TextStorage::Frame);
   }
 
   void AddPolyline(const DirectX::XMFLOAT2 *points, int num_points,
                    uint32_t col, int flags, float thickness) {
-    marker::Polyline line;
-    line.Points.assign(points, points + num_points);
-    line.Flags = flags;
-    Markers.push_back({line, col, thickness});
+    auto buffer = PointBuffer(num_points);
+    std::copy(points, points + num_points, buffer.begin());
+    Markers.push_back({marker::Polyline{buffer, flags}, col, thickness});
   }
 
   void AddConvexPolyFilled(const DirectX::XMFLOAT2 *points, int num_points,
                            uint32_t col) {
-    marker::Polyline line;
-    line.Points.assign(points, points + num_points);
-    Markers.push_back({line, col});
+    auto buffer = PointBuffer(num_points);
+    std::copy(points, points + num_points, buffer.begin());
+    Markers.push_back({marker::Polyline{buffer}, col});
+  }
+
+  marker::View View(const ViewportState &screen) const {
+    return {Markers, {screen.ViewportX, screen.ViewportY}};
   }
 
   void ToMarker(const Camera &camera, const ViewportState &screen) {
@@ -175,6 +374,7 @@ struct DrawList {
       const ViewportState &Viewport;
       DirectX::XMFLOAT4X4 Matrix;
       uint32_t Color;
+      rectray::Handle Handle;
 
       void operator()(const gizmo::Rect &r) {
         auto m = DirectX::XMLoadFloat4x4(&Matrix);
@@ -321,12 +521,97 @@ struct DrawList {
         auto [hl, hr] = gizmo::Arrow::GetSide(c0, c1);
         Self->AddTriangleFilled(c1, hl, hr, Color);
       }
+
+      void operator()(const gizmo::Point &point) {
+        auto m = DirectX::XMLoadFloat4x4(&Matrix);
+        DirectX::XMFLOAT4 p;
+        DirectX::XMStoreFloat4(&p, DirectX::XMVector3Transform(
+                                       DirectX::XMLoadFloat3(&point.P), m));
+        Self->AddCircleFilled(Viewport.ClipToViewport(p), point.Radius, Color);
+      }
+
+      // silhouette edges for the eye in mesh space. reused from the last
+      // frame for the same handle, mesh and eye
+      const std::vector<uint32_t> &
+      SilhouetteEdges(const std::shared_ptr<const TriangleMesh> &source,
+                      const DirectX::XMFLOAT3 &eye) {
+        if (!Handle) {
+          source->SilhouetteEdges(eye, &Self->m_edges);
+          return Self->m_edges;
+        }
+        auto &cached = Self->m_silhouettes[Handle.Value];
+        if (cached.Source != source || cached.Eye.x != eye.x ||
+            cached.Eye.y != eye.y || cached.Eye.z != eye.z) {
+          cached.Source = source;
+          cached.Eye = eye;
+          source->SilhouetteEdges(eye, &cached.Edges);
+        }
+        cached.Used = true;
+        return cached.Edges;
+      }
+
+      void operator()(const gizmo::Mesh &mesh) {
+        auto &source = *mesh.Source;
+        auto world = DirectX::XMLoadFloat4x4(&mesh.Matrix);
+        auto m = world * DirectX::XMLoadFloat4x4(&Matrix);
+        // one marker::Lines for all edges
+        auto emit = [&](uint32_t count, auto &&edge) {
+          auto points = Self->PointBuffer(count * 2);
+          size_t used = 0;
+          for (uint32_t i = 0; i < count; ++i) {
+            auto &e = source.Edges()[edge(i)];
+            DirectX::XMFLOAT4 p0, p1;
+            DirectX::XMStoreFloat4(
+                &p0, DirectX::XMVector3Transform(
+                         DirectX::XMLoadFloat3(&source.Vertices[e.V0]), m));
+            DirectX::XMStoreFloat4(
+                &p1, DirectX::XMVector3Transform(
+                         DirectX::XMLoadFloat3(&source.Vertices[e.V1]), m));
+            if (p0.w <= 0 || p1.w <= 0) {
+              // behind the camera
+              continue;
+            }
+            points[used++] = Viewport.ClipToViewport(p0);
+            points[used++] = Viewport.ClipToViewport(p1);
+          }
+          Self->AddLines(points.first(used), Color);
+        };
+
+        if (mesh.Wireframe) {
+          emit(static_cast<uint32_t>(source.Edges().size()),
+               [](uint32_t i) { return i; });
+        } else {
+          DirectX::XMFLOAT3 eye;
+          DirectX::XMStoreFloat3(
+              &eye, DirectX::XMVector3Transform(
+                        DirectX::XMLoadFloat3(&Camera.Transform.Translation),
+                        DirectX::XMMatrixInverse(nullptr, world)));
+          auto &edges = SilhouetteEdges(mesh.Source, eye);
+          emit(static_cast<uint32_t>(edges.size()),
+               [&edges](uint32_t i) { return edges[i]; });
+        }
+      }
     };
 
     for (auto &g : Gizmos) {
-      std::visit(GizmoVisitor{this, camera, screen, m, g.Color}, g.Shape);
+      std::visit(GizmoVisitor{this, camera, screen, m, g.Color, g.Handle},
+                 g.Shape);
     }
     Gizmos.clear();
+    for (auto it = m_silhouettes.begin(); it != m_silhouettes.end();) {
+      if (it->second.Used) {
+        it->second.Used = false;
+        ++it;
+      } else {
+        it = m_silhouettes.erase(it);
+      }
+    }
+
+    if (!Cubes.empty()) {
+      CubesToMarker(m, screen);
+      Cubes.clear();
+      CubeColors.clear();
+    }
 
     struct PrimitiveVisitor {
       DrawList *Self;
@@ -349,6 +634,17 @@ struct DrawList {
 
       void operator()(const primitive::Triangle &t) {
         auto m = DirectX::XMLoadFloat4x4(&Matrix);
+        DirectX::XMFLOAT4 p0, p1, p2;
+        DirectX::XMStoreFloat4(
+            &p0, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&t.P0), m));
+        DirectX::XMStoreFloat4(
+            &p1, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&t.P1), m));
+        DirectX::XMStoreFloat4(
+            &p2, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&t.P2), m));
+
+        Self->AddTriangleFilled(Viewport.ClipToViewport(p0),
+                                Viewport.ClipToViewport(p1),
+                                Viewport.ClipToViewport(p2), Color);
       }
     };
 
@@ -3,9 +3,14 @@
 #include "context.h"
 #include "drag/translation.h"
 #include "drawlist.h"
+#include "hiz.h"
+#include "input.h"
+#include "labels.h"
+#include "parallel.h"
 #include <DirectXMath.h>
 #include <list>
 #include <optional>
+#include <stdexcept>
 
 namespace rectray {
 
@@ -17,30 +22,383 @@ enum class Space {
   Local,
 };
 
+// deferred ray tests of the last End()
+struct PickStats {
+  // exact ray-cube tests
+  uint32_t Tested = 0;
+  // skipped by bounding sphere
+  uint32_t Pruned = 0;
+  // last frame's hover was hit again
+  bool Coherent = false;
+  // Cubes() and Points() outside the viewport. Points() behind the
+  // occlusion buffer are counted here too
+  uint32_t Culled = 0;
+  // Cubes() behind the occlusion buffer
+  uint32_t Occluded = 0;
+};
+
+// which submission won the pick of End()
+enum class HitKind {
+  None,
+  // drag handles and the other Command gizmos
+  Gizmo,
+  // Cube() and Cubes()
+  Cube,
+  Mesh,
+  // Points(). Result::Index is the point
+  Point,
+};
+
 struct Result {
-  void *Closest;
+  Handle Closest;
+  HitKind Kind;
+  // in the positions of the Points() call for HitKind::Point
+  uint32_t Index;
   bool Drag;
+  // drag in progress or hover changed. the caller should not sleep
+  bool Redraw;
   // std::optional<DirectX::XMFLOAT4X4> Updated;
 };
 
 class Gui {
   DrawList m_drawlist;
+  // before m_session, which returns its frame here
+  FramePool m_framePool;
+  DragSession m_session;
+  // mouse samples of this frame before the last one, with the left button
+  // as it was at each. viewport coordinates
+  struct Sample {
+    DirectX::XMFLOAT2 Pos;
+    bool LeftDown;
+  };
+  std::vector<Sample> m_samples;
+  // what a drag draws for those samples. not shown
+  rectray::DrawList m_sampleDrawList;
+  // see SetPrediction(). window coordinates
+  CursorPredictor m_predictor;
+  float m_predictionMs = 0;
+  // where a drag is drawn this frame. viewport coordinates
+  std::optional<DirectX::XMFLOAT2> m_predicted;
+  // the last frame's with SetDoubleBuffer(). swapped in Begin()
+  rectray::DrawList m_spare;
+  bool m_doubleBuffer = false;
   DragFunc m_drag;
+  // index of the hovered gizmo in the last frame. -1 for none
+  int m_hover = -1;
+  // Points() hovered in the last frame, apart from m_hover. a point index
+  // does not fit the gizmo indices and repeats across Points() calls
+  struct PointHover {
+    rectray::Handle Handle;
+    uint32_t Index;
+    bool operator==(const PointHover &) const = default;
+  };
+  std::optional<PointHover> m_hoverPoint;
+  bool m_dragging = false;
+  // cubes waiting for the ray test in End()
+  std::vector<gizmo::Command *> m_cubes;
+  // index in m_cubes hovered in the last frame. -1 for none
+  int m_hoverCube = -1;
+  // Cubes(). parallel to m_drawlist.Cubes
+  std::vector<Handle> m_bulkHandles;
+  std::vector<float> m_bulkHits;
+  std::vector<DirectX::XMFLOAT3> m_bulkCenters;
+  std::vector<DirectX::XMFLOAT2> m_bulkProjected;
+  std::vector<float> m_bulkW;
+  uint32_t m_culled = 0;
+  uint32_t m_occluded = 0;
+  // Cubes() of this frame as occluders. see SetOcclusion()
+  HiZ m_hiz;
+  bool m_occlusion = false;
+  std::vector<uint32_t> m_bulkKept;
+  // line handles waiting for the ray test in End(). SoA for the kernel
+  std::vector<DirectX::XMFLOAT3> m_segmentP0;
+  std::vector<DirectX::XMFLOAT3> m_segmentP1;
+  std::vector<float> m_segmentPixels;
+  std::vector<float> m_segmentHits;
+  std::vector<gizmo::Command *> m_segmentCommands;
+  // Points(). one slot per chunk
+  std::vector<kernel::PointPick> m_pointPicks;
+  std::vector<size_t> m_pointKept;
+  std::vector<size_t> m_pointBegins;
+  struct PointHit {
+    // of the Points() call
+    rectray::Handle Handle;
+    // camera distance
+    float Distance;
+    // in the positions of its Points() call
+    uint32_t Index;
+    DirectX::XMFLOAT2 Screen;
+    float Radius;
+  };
+  std::optional<PointHit> m_pointHit;
+  // Label()s of this frame, placed in Render()
+  LabelLayout m_labels;
+  // kept across frames. see SetWorkerThreads()
+  WorkerPool m_workers;
+  // called when a Translate drag begins
+  std::function<std::shared_ptr<const KdTree>()> m_snapTargets;
+  float m_snapPixels = 8;
+  std::function<SurfaceQuery()> m_surface;
+
+  BeginSessionFunc BeginTranslation(DirectX::XMFLOAT4X4 *matrix,
+                                    Translation::DragType type) {
+    return [&context = m_context, matrix, type, snap = m_snapTargets,
+            pixels = m_snapPixels, surface = m_surface](FramePool &pool) {
+      Translation translation(context, *matrix, type);
+      if (snap) {
+        translation.SnapTargets = snap();
+        translation.SnapPixels = pixels;
+      }
+      if (surface && type == Translation::DragType::SCREEN) {
+        translation.Surface = surface();
+      }
+      return TranslationSession(pool, std::move(translation));
+    };
+  }
+
+  // f(drawlist) for each earlier mouse sample of the frame, with the button
+  // of the sample, then restores the latest. the drag ends up at the latest
+  // sample but sees the path. false if the left button was released among
+  // the samples. the replay stops at the release
+  template <typename F> bool ReplaySamples(F &&f) {
+    if (m_samples.empty()) {
+      return true;
+    }
+    auto x = m_context.Viewport.MouseX;
+    auto y = m_context.Viewport.MouseY;
+    auto down = m_context.Viewport.MouseLeftDown;
+    bool held = true;
+    for (auto &sample : m_samples) {
+      m_context.SetMouse(sample.Pos.x, sample.Pos.y);
+      m_context.Viewport.MouseLeftDown = sample.LeftDown;
+      f(m_sampleDrawList);
+      m_sampleDrawList.Clear();
+      if (!sample.LeftDown) {
+        held = false;
+        break;
+      }
+    }
+    m_context.Viewport.MouseLeftDown = down;
+    m_context.SetMouse(x, y);
+    return held;
+  }
+
+  // f() at the predicted mouse of the frame, then restores the latest
+  template <typename F> void Predicted(F &&f) {
+    if (!m_predicted) {
+      f();
+      return;
+    }
+    auto x = m_context.Viewport.MouseX;
+    auto y = m_context.Viewport.MouseY;
+    m_context.SetMouse(m_predicted->x, m_predicted->y);
+    f();
+    m_context.SetMouse(x, y);
+  }
+
+  // a line handle of g, picked within pixels in End()
+  void AddSegment(gizmo::Command *g, const DirectX::XMFLOAT3 &p0,
+                  const DirectX::XMFLOAT3 &p1, float pixels) {
+    if (!m_context.Ray) {
+      return;
+    }
+    m_segmentP0.push_back(p0);
+    m_segmentP1.push_back(p1);
+    m_segmentPixels.push_back(pixels);
+    m_segmentCommands.push_back(g);
+  }
+
+  // all line handles in one kernel call. a command with several segments
+  // takes the closest
+  void PickSegments() {
+    if (!m_context.Ray || m_segmentP0.empty()) {
+      return;
+    }
+    m_segmentHits.resize(m_segmentP0.size());
+    kernel::IntersectsSegments(*m_context.Ray, m_segmentP0, m_segmentP1,
+                               m_segmentPixels, m_context.RayPixelScale(),
+                               m_segmentHits);
+    for (size_t i = 0; i < m_segmentHits.size(); ++i) {
+      auto t = m_segmentHits[i];
+      if (t == std::numeric_limits<float>::infinity()) {
+        continue;
+      }
+      auto g = m_segmentCommands[i];
+      if (!g->RayHit || t < *g->RayHit) {
+        g->RayHit = t;
+      }
+      m_hits.push_back(t);
+    }
+  }
+
+  // Exact ray tests for the deferred cubes.
+  // The cube hovered in the last frame is tested first. Its hit (or the
+  // closest arrow) bounds the rest: a cube whose bounding sphere starts
+  // beyond that distance can not be closer and is skipped.
+  void Pick() {
+    m_pickStats = {};
+    if (!m_context.Ray) {
+      return;
+    }
+    auto &ray = *m_context.Ray;
+
+    auto bound = std::numeric_limits<float>::infinity();
+    for (auto &g : m_drawlist.Gizmos) {
+      if (g.RayHit && *g.RayHit < bound) {
+        bound = *g.RayHit;
+      }
+    }
+
+    auto test = [this, &ray, &bound](gizmo::Command *g) {
+      ++m_pickStats.Tested;
+      auto &matrix = std::get<gizmo::Cube>(g->Shape).Matrix;
+      g->RayHit = Intersects(ray, DirectX::XMLoadFloat4x4(&matrix));
+      if (g->RayHit) {
+        m_hits.push_back(*g->RayHit);
+        if (*g->RayHit < bound) {
+          bound = *g->RayHit;
+        }
+      }
+      return g->RayHit.has_value();
+    };
+
+    auto prev = m_hoverCube;
+    if (prev >= 0 && prev < (int)m_cubes.size()) {
+      m_pickStats.Coherent = test(m_cubes[prev]);
+    }
+
+    for (int i = 0; i < (int)m_cubes.size(); ++i) {
+      if (i == prev) {
+        continue;
+      }
+      auto g = m_cubes[i];
+      auto &matrix = std::get<gizmo::Cube>(g->Shape).Matrix;
+      auto nearest = SphereNearBound(ray, MatrixPosition(matrix),
+                                     CubeBoundingRadius(matrix));
+      if (!nearest || *nearest >= bound) {
+        ++m_pickStats.Pruned;
+        continue;
+      }
+      test(g);
+    }
+  }
+
+  // all Cubes() in one kernel call. index in m_drawlist.Cubes or -1
+  int PickBulk() {
+    auto &cubes = m_drawlist.Cubes;
+    if (!m_context.Ray || cubes.empty()) {
+      return -1;
+    }
+    m_bulkHits.resize(cubes.size());
+    kernel::IntersectsCubes(*m_context.Ray, cubes, m_bulkHits);
+    m_pickStats.Tested += static_cast<uint32_t>(cubes.size());
+
+    int closest = -1;
+    for (int i = 0; i < (int)cubes.size(); ++i) {
+      auto t = m_bulkHits[i];
+      if (t == std::numeric_limits<float>::infinity()) {
+        continue;
+      }
+      m_hits.push_back(t);
+      if (closest < 0 || t < m_bulkHits[closest]) {
+        closest = i;
+      }
+    }
+    return closest;
+  }
 
 public:
   std::list<float> m_hits;
   Context m_context;
+  PickStats m_pickStats;
 
-  void Begin(const Camera &camera, const ViewportState &viewport) {
+  // events: the window system samples since the last frame, see
+  // InputQueue. the latest mouse move replaces the viewport's mouse and a
+  // drag is run once for each earlier one
+  void Begin(const Camera &camera, const ViewportState &viewport,
+             std::span<const InputEvent> events = {}) {
     m_hits.clear();
+    m_cubes.clear();
+    m_segmentP0.clear();
+    m_segmentP1.clear();
+    m_segmentPixels.clear();
+    m_segmentCommands.clear();
+    m_bulkHandles.clear();
+    m_culled = 0;
+    m_occluded = 0;
+    m_pointHit.reset();
+    m_labels.Clear();
+    if (m_doubleBuffer) {
+      // the buffers move with the swap. the last view stays valid
+      std::swap(m_drawlist, m_spare);
+    }
     m_drawlist.Clear();
-    m_context.Begin(camera, viewport);
+    m_samples.clear();
+    m_predicted.reset();
+    for (auto &event : events) {
+      if (event.Type == InputType::Move) {
+        m_predictor.Update(event.X, event.Y, event.Time);
+      }
+    }
+    if (viewport.Focus == ViewportFocus::None) {
+      m_context.Begin(camera, viewport);
+    } else {
+      // the left button before the first event of the frame
+      auto down = viewport.MouseLeftDown;
+      for (auto &event : events) {
+        if (event.Type == InputType::Button && event.Button == 0) {
+          down = !event.Down;
+          break;
+        }
+      }
+      for (auto &event : events) {
+        if (event.Type == InputType::Move) {
+          m_samples.push_back({{event.X - viewport.ViewportX,
+                                event.Y - viewport.ViewportY},
+                               down});
+        } else if (event.Type == InputType::Button && event.Button == 0) {
+          down = event.Down;
+          if (!m_samples.empty()) {
+            // the button changes where the cursor is
+            m_samples.push_back({m_samples.back().Pos, down});
+          }
+        }
+      }
+      if (m_predictionMs > 0) {
+        auto now = InputQueue::Now();
+        if (auto p = m_predictor.Predict(
+                now, now + static_cast<uint64_t>(m_predictionMs * 1e6f))) {
+          m_predicted = DirectX::XMFLOAT2{p->x - viewport.ViewportX,
+                                          p->y - viewport.ViewportY};
+        }
+      }
+      auto latest = viewport;
+      if (!m_samples.empty()) {
+        latest.MouseX = m_samples.back().Pos.x;
+        latest.MouseY = m_samples.back().Pos.y;
+        m_samples.pop_back();
+      }
+      m_context.Begin(camera, latest);
+    }
+    if (m_occlusion) {
+      m_hiz.Clear(viewport.ViewportWidth, viewport.ViewportHeight);
+    }
   }
 
   Result End() {
     Result result{};
     gizmo::Command *gizmo = nullptr;
+    int hover = -1;
+    std::optional<PointHover> hoverPoint;
 
+    if (m_session && !m_context.Viewport.MouseLeftDown) {
+      // released in a frame that did not resume it
+      m_session = {};
+    }
+    if (m_session) {
+      result.Drag = true;
+      result.Closest = {};
+    }
     if (m_drag) {
       if (m_context.Viewport.MouseLeftDown) {
         // drag
@@ -51,59 +409,381 @@ public:
         m_drag = {};
       }
     }
-    if (!m_drag) {
+    if (!m_drag && !m_session) {
+      // arrows first. their hits bound the cube tests
+      PickSegments();
+      Pick();
+
       auto closest = std::numeric_limits<float>::infinity();
+      int i = 0;
       for (auto &g : m_drawlist.Gizmos) {
         if (g.RayHit && *g.RayHit < closest) {
           result.Closest = g.Handle;
+          result.Kind = std::holds_alternative<gizmo::Cube>(g.Shape)
+                            ? HitKind::Cube
+                        : std::holds_alternative<gizmo::Mesh>(g.Shape)
+                            ? HitKind::Mesh
+                            : HitKind::Gizmo;
           gizmo = &g;
+          hover = i;
           closest = *g.RayHit;
         }
+        ++i;
+      }
+
+      auto bulk = PickBulk();
+      auto bulkHit = bulk >= 0 ? m_bulkHits[bulk]
+                               : std::numeric_limits<float>::infinity();
+      auto pointHit = m_pointHit ? m_pointHit->Distance
+                                 : std::numeric_limits<float>::infinity();
+      if (bulkHit < closest && bulkHit <= pointHit) {
+        result.Closest = m_bulkHandles[bulk];
+        result.Kind = HitKind::Cube;
+        gizmo = nullptr;
+        hover = static_cast<int>(m_drawlist.Gizmos.size()) + bulk;
+        m_drawlist.CubeColors[bulk] = YELLOW;
+      } else if (pointHit < closest) {
+        result.Closest = m_pointHit->Handle;
+        result.Kind = HitKind::Point;
+        result.Index = m_pointHit->Index;
+        gizmo = nullptr;
+        hover = -1;
+        hoverPoint = PointHover{m_pointHit->Handle, m_pointHit->Index};
+        m_drawlist.AddCircleFilled(m_pointHit->Screen,
+                                   m_pointHit->Radius + 2, YELLOW);
+      }
+      m_pickStats.Culled = m_culled;
+      m_pickStats.Occluded = m_occluded;
+
+      m_hoverCube = -1;
+      for (int i = 0; i < (int)m_cubes.size(); ++i) {
+        if (m_cubes[i] == gizmo) {
+          m_hoverCube = i;
+          break;
+        }
       }
 
       if (gizmo) {
         // hover
         gizmo->Color = YELLOW;
         if (m_context.Viewport.MouseLeftDown) {
-          if (gizmo->BeginDrag) {
+          if (gizmo->BeginSession) {
+            m_session = gizmo->BeginSession(m_framePool);
+          } else if (gizmo->BeginDrag) {
             m_drag = gizmo->BeginDrag();
           }
         }
       }
     }
 
+    // redraw while dragging and one more frame after it ends
+    bool dragging = m_drag || m_session;
+    result.Redraw = dragging || m_dragging || hover != m_hover ||
+                    hoverPoint != m_hoverPoint;
+    m_hover = hover;
+    m_hoverPoint = hoverPoint;
+    m_dragging = dragging;
+
     return result;
   }
   DrawList &DrawList() { return m_drawlist; }
 
+  // vertex snap for Translate drags. targets is called once per drag, so it
+  // can build or cache a KdTree lazily. empty to disable.
+  void SetSnapTargets(std::function<std::shared_ptr<const KdTree>()> targets,
+                      float pixels = 8) {
+    m_snapTargets = std::move(targets);
+    m_snapPixels = pixels;
+  }
+
+  // threads for the bulk calls (Points) and the occlusion buffer, the
+  // caller included. the workers are started here and kept. 1 runs on the
+  // caller only
+  void SetWorkerThreads(uint32_t threads) { m_workers.SetThreads(threads); }
+
+  // two DrawLists taking turns, so the markers of one frame can be drawn
+  // while the next is recorded. see FramePipeline
+  void SetDoubleBuffer(bool enable) {
+    m_doubleBuffer = enable;
+    if (!enable) {
+      m_spare = {};
+    }
+  }
+
+  // Cull Cubes() and Points() hidden behind Cubes() with a coarse software
+  // depth buffer, from both picking and the markers. the occluders are the
+  // Cubes() submitted so far in this frame, so submit them first.
+  void SetOcclusion(bool enable) { m_occlusion = enable; }
+
+  // Draw a drag at the cursor extrapolated ms ahead of Begin(), from the
+  // timestamps of its events. InputStats::DrainToPhotonMs is a good value.
+  // picking and hover stay at the real cursor. 0 turns it off
+  void SetPrediction(float ms) { m_predictionMs = std::max(ms, 0.f); }
+
+  // drop to surface for the screen handle of Translate. query is called
+  // once per drag, so it can build the scene acceleration structure then.
+  // empty to disable.
+  void SetSurfaceQuery(std::function<SurfaceQuery()> query) {
+    m_surface = std::move(query);
+  }
+
+  // project the gizmos in place. call after End() and Debug().
+  // the view is valid until the next Begin(), or the one after it with
+  // SetDoubleBuffer(true).
+  marker::View Render(const Camera &camera) {
+    m_drawlist.ToMarker(camera, m_context.Viewport);
+    if (!m_labels.Empty()) {
+      // on top of the gizmos
+      m_labels.Layout(m_context.Viewport.ViewportWidth,
+                      m_context.Viewport.ViewportHeight);
+      m_labels.Emit(&m_drawlist);
+    }
+    return m_drawlist.View(m_context.Viewport);
+  }
+
+  // text of size pixels next to a world position. Render() keeps the
+  // labels of higher priority, or nearer on a tie, and drops the ones that
+  // would overlap them
+  void Label(const DirectX::XMFLOAT3 &p, std::string_view text,
+             const DirectX::XMFLOAT2 &size, float priority = 0,
+             uint32_t color = WHITE,
+             TextStorage storage = TextStorage::Frame) {
+    DirectX::XMFLOAT4 clip;
+    DirectX::XMStoreFloat4(
+        &clip,
+        DirectX::XMVector4Transform(DirectX::XMVectorSet(p.x, p.y, p.z, 1),
+                                    m_context.Camera.ViewProjection()));
+    if (clip.w <= 0) {
+      return;
+    }
+    m_labels.Add({
+        .Anchor = m_context.Viewport.ClipToViewport(clip),
+        .Size = size,
+        .Priority = priority,
+        .Depth = clip.w,
+        .Color = color,
+        .Text = m_drawlist.StoreText(text, storage),
+    });
+  }
+
+  // Label()s of the frame and those placed by the last Render()
+  const LabelLayout &Labels() const { return m_labels; }
+
   void Arrow(const DirectX::XMFLOAT3 &s, const DirectX::XMFLOAT3 &e,
              uint32_t color, const std::function<DragFunc()> &beginDrag = {}) {
     gizmo::Arrow allow{
         s,
         e,
     };
-    auto hit = m_context.Intersects(s, e, 4);
-    m_drawlist.Gizmos.push_back({allow, color, nullptr, hit, beginDrag});
+    // the ray test is deferred to End(). see PickSegments()
+    m_drawlist.Gizmos.push_back({allow, color, {}, {}, beginDrag});
+    AddSegment(&m_drawlist.Gizmos.back(), s, e, 4);
+  }
+  void Arrow(const DirectX::XMFLOAT3 &s, const DirectX::XMFLOAT3 &e,
+             uint32_t color, const BeginSessionFunc &beginSession) {
+    Arrow(s, e, color);
+    m_drawlist.Gizmos.back().BeginSession = beginSession;
+  }
+
+  // picked within radius pixels of the projected p
+  void Point(const DirectX::XMFLOAT3 &p, float radius, uint32_t color,
+             const std::function<DragFunc()> &beginDrag = {}) {
+    std::optional<float> hit;
+    if (m_context.Ray) {
+      auto d = m_context.WorldToViewport(p) -
+               DirectX::XMFLOAT2{m_context.Viewport.MouseX,
+                                 m_context.Viewport.MouseY};
+      if (Dot(d, d) <= radius * radius) {
+        hit = Length(p - m_context.Camera.Transform.Translation);
+      }
+    }
+    m_drawlist.Gizmos.push_back(
+        {gizmo::Point{p, radius}, color, {}, hit, beginDrag});
     if (hit) {
       m_hits.push_back(*hit);
     }
   }
+  void Point(const DirectX::XMFLOAT3 &p, float radius, uint32_t color,
+             const BeginSessionFunc &beginSession) {
+    Point(p, radius, color);
+    m_drawlist.Gizmos.back().BeginSession = beginSession;
+  }
 
-  void Cube(void *handle, DirectX::XMMATRIX m) {
-    gizmo::Cube cube;
-    DirectX::XMStoreFloat4x4(&cube.Matrix, m);
-
+  // exact ray-triangle pick through the mesh bvh
+  void Mesh(Handle handle, const std::shared_ptr<const TriangleMesh> &mesh,
+            DirectX::XMMATRIX m, bool wireframe = false) {
+    gizmo::Mesh shape{mesh, {}, wireframe};
+    DirectX::XMStoreFloat4x4(&shape.Matrix, m);
     std::optional<float> hit;
-    if (auto ray = m_context.Ray) {
-      hit = Intersects(*ray, m);
+    if (m_context.Ray) {
+      hit = mesh->Intersects(*m_context.Ray, shape.Matrix);
     }
-    m_drawlist.Gizmos.push_back(
-        {cube, WHITE, handle, hit}); // hover ? YELLOW : WHITE});
+    m_drawlist.Gizmos.push_back({shape, WHITE, handle, hit});
     if (hit) {
       m_hits.push_back(*hit);
     }
   }
 
+  void Cube(Handle handle, DirectX::XMMATRIX m) {
+    gizmo::Cube cube;
+    DirectX::XMStoreFloat4x4(&cube.Matrix, m);
+
+    // the ray test is deferred to End(). see Pick()
+    m_drawlist.Gizmos.push_back(
+        {cube, WHITE, handle}); // hover ? YELLOW : WHITE});
+    if (m_context.Ray) {
+      m_cubes.push_back(&m_drawlist.Gizmos.back());
+    }
+  }
+
+  // Many cubes without a Command each. matrices and handles are parallel.
+  // Culled by bounding sphere against the viewport here, and against each
+  // other with SetOcclusion(). Picked in one batch in End(). No drag.
+  void Cubes(std::span<const DirectX::XMFLOAT4X4> matrices,
+             std::span<const Handle> handles) {
+    assert(handles.size() == matrices.size());
+    auto &camera = m_context.Camera;
+    auto &viewport = m_context.Viewport;
+
+    auto count = matrices.size();
+    m_bulkCenters.resize(count);
+    m_bulkProjected.resize(count);
+    m_bulkW.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      m_bulkCenters[i] = MatrixPosition(matrices[i]);
+    }
+    DirectX::XMFLOAT4X4 vp;
+    DirectX::XMStoreFloat4x4(&vp, camera.ViewProjection());
+    kernel::ProjectPoints(vp, viewport.ViewportWidth, viewport.ViewportHeight,
+                          m_bulkCenters, m_bulkProjected, m_bulkW);
+
+    // pixels per world unit at w = 1
+    auto scale = 0.5f * std::max(camera.ProjectionMatrix._11 *
+                                     viewport.ViewportWidth,
+                                 camera.ProjectionMatrix._22 *
+                                     viewport.ViewportHeight);
+    m_bulkKept.clear();
+    for (size_t i = 0; i < count; ++i) {
+      auto radius = CubeBoundingRadius(matrices[i]);
+      auto w = m_bulkW[i];
+      if (w + radius <= camera.Projection.NearZ) {
+        ++m_culled;
+        continue;
+      }
+      // w <= radius: the camera may be inside. keep
+      if (w > radius) {
+        // r / (w - r) is above the projected radius, as in HiZ::Occluded
+        auto r = radius * scale / (w - radius);
+        auto &p = m_bulkProjected[i];
+        if (p.x + r < 0 || p.x - r > viewport.ViewportWidth || p.y + r < 0 ||
+            p.y - r > viewport.ViewportHeight) {
+          ++m_culled;
+          continue;
+        }
+      }
+      m_bulkKept.push_back(static_cast<uint32_t>(i));
+    }
+
+    if (m_occlusion) {
+      // the inscribed sphere occludes. all of them before any test, so the
+      // cubes of this call hide each other
+      for (auto i : m_bulkKept) {
+        auto &m = matrices[i];
+        auto inner = 0.5f * std::min({Length(MatrixAxisX(m)),
+                                      Length(MatrixAxisY(m)),
+                                      Length(MatrixAxisZ(m))});
+        m_hiz.AddOccluder(m_bulkProjected[i], m_bulkW[i], inner, scale);
+      }
+      m_hiz.Update(&m_workers);
+    }
+
+    for (auto i : m_bulkKept) {
+      if (m_occlusion &&
+          m_hiz.Occluded(m_bulkProjected[i], m_bulkW[i],
+                         CubeBoundingRadius(matrices[i]), scale)) {
+        ++m_occluded;
+        continue;
+      }
+      m_drawlist.Cubes.push_back(matrices[i]);
+      m_drawlist.CubeColors.push_back(WHITE);
+      m_bulkHandles.push_back(handles[i]);
+    }
+  }
+
+  // Millions of point handles without a Command each. handle names the
+  // whole set, a hit reports HitKind::Point and the index in positions.
+  // Projected, culled and emitted as marker::Points here, in chunks on the
+  // worker threads. The kept point nearest the cursor within pickPixels
+  // competes in End() at its camera distance. No drag.
+  void Points(Handle handle, std::span<const DirectX::XMFLOAT3> positions,
+              float radius = 2, uint32_t color = WHITE,
+              float pickPixels = 6) {
+    if (positions.size() >= UINT32_MAX) {
+      // the pick index is 32 bit, UINT32_MAX for none
+      throw std::length_error("Gui::Points: too many positions");
+    }
+    auto &camera = m_context.Camera;
+    auto &viewport = m_context.Viewport;
+    kernel::PointCull cull{
+        .Width = viewport.ViewportWidth,
+        .Height = viewport.ViewportHeight,
+        .Margin = radius,
+        .NearW = camera.Projection.NearZ,
+        .Cursor = {viewport.MouseX, viewport.MouseY},
+        // nothing is closer than 0
+        .PickRadius = m_context.Ray ? pickPixels : 0,
+    };
+    DirectX::XMStoreFloat4x4(&cull.ViewProjection, camera.ViewProjection());
+    if (m_occlusion && !m_hiz.Empty()) {
+      cull.Depth = m_hiz.Depth();
+      cull.DepthWidth = m_hiz.Width();
+      cull.DepthHeight = m_hiz.Height();
+      cull.DepthCell = HiZ::CELL;
+    }
+
+    // a chunk writes its kept points to the front of its own range
+    const size_t MIN_CHUNK = 1 << 16;
+    auto out = m_drawlist.PointBuffer(positions.size());
+    auto threads = m_workers.Threads();
+    m_pointPicks.assign(threads, {});
+    m_pointKept.assign(threads, 0);
+    m_pointBegins.assign(threads, 0);
+    auto chunks = ParallelFor(
+        &m_workers, positions.size(), MIN_CHUNK,
+        [&](uint32_t chunk, size_t begin, size_t end) {
+          auto &pick = m_pointPicks[chunk];
+          m_pointKept[chunk] = kernel::CullPoints(
+              cull, positions.subspan(begin, end - begin),
+              out.subspan(begin, end - begin), &pick);
+          if (pick.Index != UINT32_MAX) {
+            pick.Index += static_cast<uint32_t>(begin);
+          }
+          m_pointBegins[chunk] = begin;
+        });
+
+    kernel::PointPick nearest;
+    size_t kept = 0;
+    for (uint32_t i = 0; i < chunks; ++i) {
+      if (m_pointPicks[i].Distance2 < nearest.Distance2) {
+        nearest = m_pointPicks[i];
+      }
+      kept += m_pointKept[i];
+      m_drawlist.AddPoints(out.subspan(m_pointBegins[i], m_pointKept[i]),
+                           radius, color);
+    }
+    m_culled += static_cast<uint32_t>(positions.size() - kept);
+
+    if (nearest.Index != UINT32_MAX) {
+      auto &p = positions[nearest.Index];
+      auto distance = Length(p - camera.Transform.Translation);
+      if (!m_pointHit || distance < m_pointHit->Distance) {
+        m_pointHit = PointHit{handle, distance, nearest.Index,
+                              m_context.WorldToViewport(p), radius};
+      }
+      m_hits.push_back(distance);
+    }
+  }
+
   void Frustum(DirectX::XMMATRIX ViewProjection, float zNear, float zFar) {
     gizmo::Frustum frustum{
         .Near = zNear,
@@ -151,24 +831,41 @@ public:
     // Arrow(s, {s.x, s.y + 1, s.z}, 0xFF00FF00, Translate::LocalY);
     // Arrow(s, {s.x, s.y, s.z + 1}, 0xFFFF0000, Translate::LocalZ);
 
+    if (m_session) {
+      ReplaySamples([this, matrix](rectray::DrawList &drawlist) {
+        m_session.Resume({&m_context, matrix, &drawlist});
+      });
+    }
+    if (m_session) {
+      bool running = true;
+      Predicted([this, matrix, &running]() {
+        running = m_session.Resume({&m_context, matrix, &m_drawlist});
+      });
+      if (running) {
+        return true;
+      }
+    }
+    if (m_drag && m_context.Viewport.MouseLeftDown &&
+        !ReplaySamples([this, matrix](rectray::DrawList &drawlist) {
+          m_drag(m_context, matrix, drawlist);
+        })) {
+      // released among the samples. a later press is not this drag
+      m_drag = {};
+    }
     if (m_drag && m_context.Viewport.MouseLeftDown) {
       // drag
       // Arrow(s, {s.x + 1, s.y, s.z}, 0xFF00FFFF);
-      m_drag(m_context, matrix, m_drawlist);
+      Predicted([this, matrix]() { m_drag(m_context, matrix, m_drawlist); });
       return true;
     } else {
       Arrow(s, {s.x + 1, s.y, s.z}, 0xFF0000FF,
-            [&context = m_context, matrix]() {
-              return Translation(context, *matrix, Translation::DragType::X);
-            });
+            BeginTranslation(matrix, Translation::DragType::X));
       Arrow(s, {s.x, s.y + 1, s.z}, 0xFF00FF00,
-            [&context = m_context, matrix]() {
-              return Translation(context, *matrix, Translation::DragType::Y);
-            });
+            BeginTranslation(matrix, Translation::DragType::Y));
       Arrow(s, {s.x, s.y, s.z + 1}, 0xFFFF0000,
-            [&context = m_context, matrix]() {
-              return Translation(context, *matrix, Translation::DragType::Z);
-            });
+            BeginTranslation(matrix, Translation::DragType::Z));
+      Point(s, 6, 0xFFFFFFFF,
+            BeginTranslation(matrix, Translation::DragType::SCREEN));
       return false;
     }
   }
@@ -0,0 +1,138 @@
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace rectray {
+
+// 64 bit gizmo identity. slot index, tag of the pool and the generation of
+// the slot. the generation changes when the slot is released, so a handle
+// kept after Release() no longer resolves. a pool does not resolve a handle
+// of another tag. 0 is invalid.
+struct Handle {
+  static constexpr uint32_t INDEX_BITS = 24;
+  static constexpr uint32_t TAG_BITS = 8;
+  static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+  static constexpr uint32_t TAG_MASK = (1u << TAG_BITS) - 1;
+  // the upper 32 bits
+  static constexpr uint32_t GENERATION_MASK = UINT32_MAX;
+
+  uint64_t Value = 0;
+
+  static Handle Make(uint32_t index, uint32_t generation, uint32_t tag = 0) {
+    assert(index <= INDEX_MASK);
+    assert(tag <= TAG_MASK);
+    assert(generation != 0);
+    return {static_cast<uint64_t>(generation) << 32 | tag << INDEX_BITS |
+            index};
+  }
+
+  uint32_t Index() const { return Value & INDEX_MASK; }
+  uint32_t Tag() const { return Value >> INDEX_BITS & TAG_MASK; }
+  uint32_t Generation() const { return static_cast<uint32_t>(Value >> 32); }
+
+  explicit operator bool() const { return Value != 0; }
+  bool operator==(const Handle &) const = default;
+};
+static_assert(sizeof(Handle) == 8);
+
+// Handle to T. Resolve() is an index and a compare.
+// give pools whose handles can meet, like the results of one Gui, distinct
+// tags. Create() returns an invalid Handle when INDEX_MASK + 1 slots are
+// taken. a slot whose generation runs out is retired, not reused, so a
+// stale handle never resolves to a later value.
+template <typename T> class HandlePool {
+  struct Slot {
+    T Value{};
+    // 0 while free
+    uint32_t Generation = 0;
+    // generation of the next Create() in this slot
+    uint32_t Next = 1;
+  };
+  std::vector<Slot> m_slots;
+  std::vector<uint32_t> m_free;
+  size_t m_size = 0;
+  uint32_t m_tag;
+
+public:
+  explicit HandlePool(uint32_t tag = 0) : m_tag(tag) {
+    assert(tag <= Handle::TAG_MASK);
+  }
+
+  size_t Size() const { return m_size; }
+  uint32_t Tag() const { return m_tag; }
+
+  Handle Create(T value) {
+    uint32_t index;
+    if (!m_free.empty()) {
+      index = m_free.back();
+      m_free.pop_back();
+    } else {
+      index = static_cast<uint32_t>(m_slots.size());
+      if (index > Handle::INDEX_MASK) {
+        // full. the index would reach the tag
+        return {};
+      }
+      m_slots.push_back({});
+    }
+    auto &slot = m_slots[index];
+    slot.Value = std::move(value);
+    slot.Generation = slot.Next;
+    ++m_size;
+    return Handle::Make(index, slot.Generation, m_tag);
+  }
+
+  // false if the handle is already stale
+  bool Release(Handle handle) {
+    auto slot = Find(handle);
+    if (!slot) {
+      return false;
+    }
+    slot->Value = {};
+    auto retired = slot->Generation == Handle::GENERATION_MASK;
+    slot->Next = slot->Generation + 1;
+    slot->Generation = 0;
+    if (!retired) {
+      m_free.push_back(handle.Index());
+    }
+    --m_size;
+    return true;
+  }
+
+  // nullptr for an invalid or stale handle
+  T *Resolve(Handle handle) {
+    auto slot = Find(handle);
+    return slot ? &slot->Value : nullptr;
+  }
+  const T *Resolve(Handle handle) const {
+    return const_cast<HandlePool *>(this)->Resolve(handle);
+  }
+
+  void Clear() {
+    // keep the generations. old handles stay stale
+    for (uint32_t i = 0; i < m_slots.size(); ++i) {
+      if (m_slots[i].Generation) {
+        Release(Handle::Make(i, m_slots[i].Generation, m_tag));
+      }
+    }
+  }
+
+private:
+  Slot *Find(Handle handle) {
+    if (!handle || handle.Tag() != m_tag) {
+      return nullptr;
+    }
+    auto index = handle.Index();
+    if (index >= m_slots.size()) {
+      return nullptr;
+    }
+    auto &slot = m_slots[index];
+    if (slot.Generation != handle.Generation()) {
+      return nullptr;
+    }
+    return &slot;
+  }
+};
+
+} // namespace rectray
@@ -0,0 +1,150 @@
+#pragma once
+#include "linearalgebra.h"
+#include <span>
+#include <vector>
+
+namespace rectray {
+
+//
+// Parent/child rigid transforms in flat arrays.
+//
+// * a parent is stored before its children. one forward pass updates all
+// * Update() recomputes only the dirty nodes and their descendants
+// * world = local * parent world (row vectors)
+//
+class TransformHierarchy {
+  std::vector<int32_t> m_parents;
+  // EuclideanTransform as separate arrays
+  std::vector<DirectX::XMFLOAT4> m_rotations;
+  std::vector<DirectX::XMFLOAT3> m_translations;
+  std::vector<DirectX::XMFLOAT4X4> m_worlds;
+  std::vector<uint8_t> m_dirty;
+  // smallest dirty index. Size() when clean
+  uint32_t m_firstDirty = 0;
+  // recomputed by the last Update()
+  std::vector<uint32_t> m_changed;
+
+  void MarkDirty(uint32_t i) {
+    m_dirty[i] = true;
+    m_firstDirty = std::min(m_firstDirty, i);
+  }
+
+public:
+  static const int32_t ROOT = -1;
+
+  uint32_t Size() const { return static_cast<uint32_t>(m_parents.size()); }
+
+  // parent must already exist. returns the new index
+  uint32_t Add(const EuclideanTransform &local, int32_t parent = ROOT) {
+    assert(parent < static_cast<int32_t>(Size()));
+    auto index = Size();
+    m_parents.push_back(parent);
+    m_rotations.push_back(local.Rotation);
+    m_translations.push_back(local.Translation);
+    m_worlds.push_back({});
+    m_dirty.push_back(false);
+    MarkDirty(index);
+    return index;
+  }
+
+  bool HasChildren(uint32_t i) const {
+    for (auto j = i + 1; j < Size(); ++j) {
+      if (m_parents[j] == static_cast<int32_t>(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // a leaf only. later indices shift down by one
+  bool Remove(uint32_t i) {
+    if (HasChildren(i)) {
+      return false;
+    }
+    m_parents.erase(m_parents.begin() + i);
+    m_rotations.erase(m_rotations.begin() + i);
+    m_translations.erase(m_translations.begin() + i);
+    m_worlds.erase(m_worlds.begin() + i);
+    m_dirty.erase(m_dirty.begin() + i);
+    for (auto j = i; j < Size(); ++j) {
+      if (m_parents[j] > static_cast<int32_t>(i)) {
+        --m_parents[j];
+      }
+    }
+    if (m_firstDirty > i) {
+      // the dirty row past i moved down with the rest
+      --m_firstDirty;
+    }
+    return true;
+  }
+
+  int32_t Parent(uint32_t i) const { return m_parents[i]; }
+
+  EuclideanTransform Local(uint32_t i) const {
+    return {m_rotations[i], m_translations[i]};
+  }
+
+  void SetLocal(uint32_t i, const EuclideanTransform &local) {
+    m_rotations[i] = local.Rotation;
+    m_translations[i] = local.Translation;
+    MarkDirty(i);
+  }
+
+  // the local is solved against the parent world of the last Update().
+  // scaling in world is dropped.
+  bool SetWorldMatrix(uint32_t i, DirectX::XMMATRIX world) {
+    auto local = world;
+    if (auto parent = m_parents[i]; parent != ROOT) {
+      local = world * DirectX::XMMatrixInverse(
+                          nullptr, DirectX::XMLoadFloat4x4(&m_worlds[parent]));
+    }
+    DirectX::XMVECTOR s;
+    DirectX::XMVECTOR r;
+    DirectX::XMVECTOR t;
+    if (!DirectX::XMMatrixDecompose(&s, &r, &t, local)) {
+      return false;
+    }
+    DirectX::XMStoreFloat4(&m_rotations[i], r);
+    DirectX::XMStoreFloat3(&m_translations[i], t);
+    MarkDirty(i);
+    return true;
+  }
+
+  // valid after Update()
+  const DirectX::XMFLOAT4X4 &World(uint32_t i) const { return m_worlds[i]; }
+  std::span<const DirectX::XMFLOAT4X4> Worlds() const { return m_worlds; }
+
+  // indices recomputed by the last Update(), ascending
+  std::span<const uint32_t> Changed() const { return m_changed; }
+
+  void Update() {
+    m_changed.clear();
+    auto size = Size();
+    for (auto i = m_firstDirty; i < size; ++i) {
+      auto parent = m_parents[i];
+      if (parent != ROOT && m_dirty[parent]) {
+        // propagate
+        m_dirty[i] = true;
+      }
+      if (!m_dirty[i]) {
+        continue;
+      }
+      auto local = DirectX::XMMatrixRotationQuaternion(
+                       DirectX::XMLoadFloat4(&m_rotations[i])) *
+                   DirectX::XMMatrixTranslation(m_translations[i].x,
+                                                m_translations[i].y,
+                                                m_translations[i].z);
+      if (parent != ROOT) {
+        local = local * DirectX::XMLoadFloat4x4(&m_worlds[parent]);
+      }
+      DirectX::XMStoreFloat4x4(&m_worlds[i], local);
+      m_changed.push_back(i);
+    }
+    for (auto i : m_changed) {
+      m_dirty[i] = false;
+    }
+    m_firstDirty = size;
+  }
+};
+
+} // namespace rectray
@@ -0,0 +1,194 @@
+#pragma once
+#include "linearalgebra.h"
+#include "parallel.h"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+namespace rectray {
+
+//
+// Coarse software depth buffer for occlusion culling. CPU only.
+//
+// * one cell per CELL x CELL viewport pixels holds a view depth (clip w)
+//   beyond which the cell is certainly covered. +inf where nothing is
+// * occluders are spheres inside an object. the inner square of the
+//   projected disc is rounded in to whole cells and written at the far side
+//   of the sphere, so a cell never claims more than is covered
+// * level k + 1 holds the max of 2x2 cells of level k. a query reads the
+//   finest level where its rect spans at most 4x4 cells
+// * Update() rasterizes in bands of rows on the worker threads. each band
+//   walks the occluders overlapping it and writes only its own rows
+//
+class HiZ {
+public:
+  static const uint32_t CELL = 8;
+
+private:
+  struct Occluder {
+    // cells [X0, X1) x [Y0, Y1)
+    int32_t X0;
+    int32_t Y0;
+    int32_t X1;
+    int32_t Y1;
+    float Depth;
+  };
+  std::vector<Occluder> m_occluders;
+  struct Level {
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<float> Depth;
+  };
+  std::vector<Level> m_levels;
+  bool m_empty = true;
+
+  void BuildLevels() {
+    for (size_t k = 1; k < m_levels.size(); ++k) {
+      auto &src = m_levels[k - 1];
+      auto &dst = m_levels[k];
+      for (uint32_t y = 0; y < dst.Height; ++y) {
+        auto y0 = y * 2;
+        auto y1 = std::min(y0 + 1, src.Height - 1);
+        for (uint32_t x = 0; x < dst.Width; ++x) {
+          auto x0 = x * 2;
+          auto x1 = std::min(x0 + 1, src.Width - 1);
+          dst.Depth[y * dst.Width + x] = std::max(
+              {src.Depth[y0 * src.Width + x0], src.Depth[y0 * src.Width + x1],
+               src.Depth[y1 * src.Width + x0], src.Depth[y1 * src.Width + x1]});
+        }
+      }
+    }
+  }
+
+public:
+  // level 0 row major. valid after Update()
+  uint32_t Width() const { return m_levels.empty() ? 0 : m_levels[0].Width; }
+  uint32_t Height() const { return m_levels.empty() ? 0 : m_levels[0].Height; }
+  const float *Depth() const {
+    return m_levels.empty() ? nullptr : m_levels[0].Depth.data();
+  }
+  // nothing is occluded
+  bool Empty() const { return m_empty; }
+
+  void Clear(float viewportWidth, float viewportHeight) {
+    m_occluders.clear();
+    m_empty = true;
+    auto width = std::max(
+        static_cast<uint32_t>(ceilf(viewportWidth / CELL)), uint32_t{1});
+    auto height = std::max(
+        static_cast<uint32_t>(ceilf(viewportHeight / CELL)), uint32_t{1});
+    if (m_levels.empty() || m_levels[0].Width != width ||
+        m_levels[0].Height != height) {
+      m_levels.clear();
+      while (true) {
+        m_levels.push_back({width, height, {}});
+        m_levels.back().Depth.resize(width * height);
+        if (width == 1 && height == 1) {
+          break;
+        }
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+      }
+    }
+    for (auto &level : m_levels) {
+      std::fill(level.Depth.begin(), level.Depth.end(),
+                std::numeric_limits<float>::infinity());
+    }
+  }
+
+  // a sphere inside the object. screen center, clip w of the center and
+  // pixels per world unit at w = 1. ignored until Update()
+  void AddOccluder(const DirectX::XMFLOAT2 &center, float w, float radius,
+                   float scale) {
+    if (w <= radius) {
+      // the camera may be inside
+      return;
+    }
+    // inner square of the projected disc. r / w is below the true
+    // projected radius r / sqrt(w^2 - r^2)
+    auto half = 0.7071f * radius * scale / w;
+    Occluder o{
+        static_cast<int32_t>(ceilf((center.x - half) / CELL)),
+        static_cast<int32_t>(ceilf((center.y - half) / CELL)),
+        static_cast<int32_t>(floorf((center.x + half) / CELL)),
+        static_cast<int32_t>(floorf((center.y + half) / CELL)),
+        w + radius,
+    };
+    o.X0 = std::max(o.X0, 0);
+    o.Y0 = std::max(o.Y0, 0);
+    o.X1 = std::min(o.X1, static_cast<int32_t>(Width()));
+    o.Y1 = std::min(o.Y1, static_cast<int32_t>(Height()));
+    if (o.X0 < o.X1 && o.Y0 < o.Y1) {
+      m_occluders.push_back(o);
+    }
+  }
+
+  // rasterize the occluders added since the last Update() and rebuild the
+  // levels
+  void Update(WorkerPool *workers = nullptr) {
+    if (m_occluders.empty()) {
+      return;
+    }
+    auto &level = m_levels[0];
+    const size_t MIN_ROWS = 8;
+    ParallelFor(workers, level.Height, MIN_ROWS,
+                [this, &level](uint32_t, size_t begin, size_t end) {
+                  auto rowBegin = static_cast<int32_t>(begin);
+                  auto rowEnd = static_cast<int32_t>(end);
+                  for (auto &o : m_occluders) {
+                    auto y0 = std::max(o.Y0, rowBegin);
+                    auto y1 = std::min(o.Y1, rowEnd);
+                    for (auto y = y0; y < y1; ++y) {
+                      auto row = &level.Depth[y * level.Width];
+                      for (auto x = o.X0; x < o.X1; ++x) {
+                        row[x] = std::min(row[x], o.Depth);
+                      }
+                    }
+                  }
+                });
+    m_occluders.clear();
+    BuildLevels();
+    m_empty = false;
+  }
+
+  // a sphere that is certainly behind the occluders. screen center, clip w
+  // of the center and pixels per world unit at w = 1
+  bool Occluded(const DirectX::XMFLOAT2 &center, float w, float radius,
+                float scale) const {
+    auto nearW = w - radius;
+    if (m_empty || nearW <= 0) {
+      return false;
+    }
+    // r / (w - r) is above the projected radius. one more pixel for the
+    // rounding
+    auto r = radius * scale / nearW + 1;
+    auto x0 = std::max(static_cast<int32_t>(floorf((center.x - r) / CELL)), 0);
+    auto y0 = std::max(static_cast<int32_t>(floorf((center.y - r) / CELL)), 0);
+    auto x1 = std::min(static_cast<int32_t>(floorf((center.x + r) / CELL)),
+                       static_cast<int32_t>(Width()) - 1);
+    auto y1 = std::min(static_cast<int32_t>(floorf((center.y + r) / CELL)),
+                       static_cast<int32_t>(Height()) - 1);
+    if (x0 > x1 || y0 > y1) {
+      // off screen. the viewport cull decides
+      return false;
+    }
+    uint32_t k = 0;
+    while (k + 1 < m_levels.size() &&
+           std::max((x1 >> k) - (x0 >> k), (y1 >> k) - (y0 >> k)) >= 4) {
+      ++k;
+    }
+    auto &level = m_levels[k];
+    for (auto y = y0 >> k; y <= y1 >> k; ++y) {
+      for (auto x = x0 >> k; x <= x1 >> k; ++x) {
+        if (level.Depth[y * level.Width + x] >= nearW) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace rectray
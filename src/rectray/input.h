@@ -0,0 +1,260 @@
+#pragma once
+#include <DirectXMath.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+namespace rectray {
+
+enum class InputType : uint8_t {
+  Move,
+  Button,
+  Wheel,
+};
+
+// one window system sample. window coordinates
+struct InputEvent {
+  InputType Type = InputType::Move;
+  // Button: 0 left, 1 right, 2 middle
+  uint8_t Button = 0;
+  bool Down = false;
+  // Move
+  float X = 0;
+  float Y = 0;
+  // Wheel
+  float Wheel = 0;
+  // InputQueue::Now() when it arrived
+  uint64_t Time = 0;
+};
+
+//
+// Single producer, single consumer ring. Lock free.
+//
+// * N is a power of 2. the indices run freely and wrap with the mask
+// * the producer owns m_tail, the consumer m_head. each reads the other's
+//   with acquire and publishes its own with release
+// * both on their own cache line, so the two threads do not share one
+//
+template <typename T, uint32_t N> class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+  alignas(64) std::atomic<uint32_t> m_head{0};
+  alignas(64) std::atomic<uint32_t> m_tail{0};
+  alignas(64) T m_items[N];
+
+public:
+  // producer. false when full
+  bool Push(const T &item) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    m_items[tail & (N - 1)] = item;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer. false when empty
+  bool Pop(T *item) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = m_items[head & (N - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+struct InputStats {
+  // events of the last Drain()
+  uint32_t Events = 0;
+  // pushed on a full queue, since the start
+  uint32_t Dropped = 0;
+  // age of the oldest and the newest event at the last Drain(). ms
+  float OldestMs = 0;
+  float NewestMs = 0;
+  // largest OldestMs since the start
+  float MaxMs = 0;
+  // by InputQueue::Presented(). ms, averaged over the last frames.
+  // newest event of a frame to its swap
+  float MotionToPhotonMs = 0;
+  // Drain() to the swap. how far a cursor prediction should look ahead
+  float DrainToPhotonMs = 0;
+};
+
+//
+// Mouse samples from the window system callbacks to Gui, all of them
+// instead of one per frame.
+//
+// * Push() from the callback thread, Drain() once a frame from the thread
+//   that calls Gui::Begin()
+// * a full queue drops the new sample and counts it
+//
+class InputQueue {
+public:
+  static const uint32_t CAPACITY = 1024;
+  // frames a Presented() may lag its Drain()
+  static constexpr uint32_t MAX_FRAMES_LATE = 3;
+
+private:
+  SpscQueue<InputEvent, CAPACITY> m_queue;
+  std::atomic<uint32_t> m_dropped{0};
+  InputStats m_stats;
+  struct Drained {
+    uint64_t Time = 0;
+    // 0 when the frame had no event
+    uint64_t Newest = 0;
+  };
+  // the last Drain()s, newest first
+  Drained m_drained[MAX_FRAMES_LATE + 1];
+
+public:
+  // steady clock nanoseconds, for InputEvent::Time
+  static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // producer. stamps the event if it is not
+  bool Push(InputEvent event) {
+    if (event.Time == 0) {
+      event.Time = Now();
+    }
+    if (!m_queue.Push(event)) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  // consumer. out is replaced by the pending events, oldest first
+  const InputStats &Drain(std::vector<InputEvent> *out) {
+    out->clear();
+    InputEvent event;
+    while (m_queue.Pop(&event)) {
+      out->push_back(event);
+    }
+    auto now = Now();
+    m_stats.Events = static_cast<uint32_t>(out->size());
+    m_stats.Dropped = m_dropped.load(std::memory_order_relaxed);
+    if (out->empty()) {
+      m_stats.OldestMs = m_stats.NewestMs = 0;
+    } else {
+      m_stats.OldestMs = (now - out->front().Time) * 1e-6f;
+      m_stats.NewestMs = (now - out->back().Time) * 1e-6f;
+      m_stats.MaxMs = std::max(m_stats.MaxMs, m_stats.OldestMs);
+    }
+    std::copy_backward(m_drained, m_drained + MAX_FRAMES_LATE,
+                       m_drained + MAX_FRAMES_LATE + 1);
+    m_drained[0] = {now, out->empty() ? 0 : out->back().Time};
+    return m_stats;
+  }
+
+  // consumer. call when the swap of a frame returns. framesLate is how many
+  // Drain()s ago that frame was drained, 1 when it was recorded a frame
+  // ahead. the swap may return before the scan out, which adds up to one
+  // refresh more
+  void Presented(uint32_t framesLate = 0) {
+    auto &drained = m_drained[std::min(framesLate, MAX_FRAMES_LATE)];
+    if (drained.Time == 0) {
+      return;
+    }
+    const float SMOOTH = 0.1f;
+    auto now = Now();
+    auto drainMs = (now - drained.Time) * 1e-6f;
+    m_stats.DrainToPhotonMs = m_stats.DrainToPhotonMs == 0
+                                  ? drainMs
+                                  : m_stats.DrainToPhotonMs +
+                                        (drainMs - m_stats.DrainToPhotonMs) *
+                                            SMOOTH;
+    if (drained.Newest) {
+      auto motionMs = (now - drained.Newest) * 1e-6f;
+      m_stats.MotionToPhotonMs =
+          m_stats.MotionToPhotonMs == 0
+              ? motionMs
+              : m_stats.MotionToPhotonMs +
+                    (motionMs - m_stats.MotionToPhotonMs) * SMOOTH;
+    }
+  }
+
+  const InputStats &Stats() const { return m_stats; }
+};
+
+//
+// Constant velocity extrapolation of the cursor, to draw a drag where the
+// cursor will be when the frame is shown instead of where it was.
+//
+// * Update() with every move. the velocity is the mean over the samples of
+//   the last WINDOW_MS, so the spacing of the samples does not matter
+// * Predict() extrapolates from the newest sample, at most MAX_AHEAD_MS.
+//   a cursor that has not moved for STILL_MS before now stays where it is,
+//   however far ahead the prediction is
+// * nothing is filtered. the next real sample replaces the prediction
+//
+class CursorPredictor {
+public:
+  static constexpr float WINDOW_MS = 32;
+  static constexpr float MAX_AHEAD_MS = 50;
+  static constexpr float STILL_MS = 40;
+
+private:
+  struct Sample {
+    float X;
+    float Y;
+    uint64_t Time;
+  };
+  static constexpr uint32_t N = 16;
+  Sample m_samples[N];
+  uint32_t m_count = 0;
+  // next write
+  uint32_t m_next = 0;
+
+public:
+  void Reset() { m_count = m_next = 0; }
+
+  void Update(float x, float y, uint64_t time) {
+    m_samples[m_next] = {x, y, time};
+    m_next = (m_next + 1) % N;
+    m_count = std::min(m_count + 1, N);
+  }
+
+  // the cursor at time, predicted at now. nullopt without samples
+  std::optional<DirectX::XMFLOAT2> Predict(uint64_t now, uint64_t time) const {
+    if (m_count == 0) {
+      return std::nullopt;
+    }
+    auto &newest = m_samples[(m_next + N - 1) % N];
+    DirectX::XMFLOAT2 p{newest.X, newest.Y};
+    auto still = now > newest.Time && (now - newest.Time) * 1e-6f > STILL_MS;
+    if (time <= newest.Time || still || m_count < 2) {
+      return p;
+    }
+    // the oldest sample within the window
+    auto oldest = &newest;
+    for (uint32_t i = 2; i <= m_count; ++i) {
+      auto &s = m_samples[(m_next + N - i) % N];
+      if ((newest.Time - s.Time) * 1e-6f > WINDOW_MS) {
+        break;
+      }
+      oldest = &s;
+    }
+    if (oldest == &newest) {
+      return p;
+    }
+    auto dt = (newest.Time - oldest->Time) * 1e-6f;
+    if (dt <= 0) {
+      // samples of the same time. no velocity
+      return p;
+    }
+    auto ahead = std::min((time - newest.Time) * 1e-6f, MAX_AHEAD_MS);
+    p.x += (newest.X - oldest->X) / dt * ahead;
+    p.y += (newest.Y - oldest->Y) / dt * ahead;
+    return p;
+  }
+};
+
+} // namespace rectray
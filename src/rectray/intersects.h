@@ -1,4 +1,5 @@
 #pragma once
+#include "kernels.h"
 #include "linearalgebra.h"
 
 namespace rectray {
@@ -32,6 +33,74 @@ inline std::optional<float> Intersects(const Ray &ray, const Plain &plain) {
 //   }
 // }
 
+// radius of a sphere around the unit cube [-0.5, 0.5] transformed by m
+inline float CubeBoundingRadius(const DirectX::XMFLOAT4X4 &m) {
+  return 0.5f * (Length(MatrixAxisX(m)) + Length(MatrixAxisY(m)) +
+                 Length(MatrixAxisZ(m)));
+}
+
+// lower bound of the ray distance to anything inside the sphere.
+// nullopt if the ray misses the sphere.
+inline std::optional<float> SphereNearBound(const Ray &ray,
+                                            const DirectX::XMFLOAT3 &center,
+                                            float radius) {
+  auto oc = center - ray.Origin;
+  auto t = Dot(oc, ray.Direction);
+  auto d2 = Dot(oc, oc) - t * t;
+  if (d2 > radius * radius) {
+    return std::nullopt;
+  }
+  return t - radius;
+}
+
+// ray vs unit cube [-0.5, 0.5] transformed by m (orthogonal axes).
+// same slab test as kernel::IntersectsCubes, plus the normal of the entry
+// face. the exit face when the origin is inside.
+inline std::optional<float> IntersectsCube(const Ray &ray,
+                                           const DirectX::XMFLOAT4X4 &m,
+                                           DirectX::XMFLOAT3 *normal) {
+  auto c = MatrixPosition(m) - ray.Origin;
+  float tNear = -std::numeric_limits<float>::infinity();
+  float tFar = std::numeric_limits<float>::infinity();
+  int nearAxis = 0;
+  int farAxis = 0;
+  float nearSign = 1;
+  float farSign = 1;
+  for (int axis = 0; axis < 3; ++axis) {
+    auto a = MatrixRow(m, axis);
+    auto inv = 1.0f / Dot(a, a);
+    auto e = Dot(a, c) * inv;
+    auto f = Dot(a, ray.Direction) * inv;
+    auto t0 = (e - 0.5f) / f;
+    auto t1 = (e + 0.5f) / f;
+    // t0 enters the -axis face
+    float sign = -1;
+    if (t0 > t1) {
+      std::swap(t0, t1);
+      sign = 1;
+    }
+    if (t0 > tNear) {
+      tNear = t0;
+      nearAxis = axis;
+      nearSign = sign;
+    }
+    if (t1 < tFar) {
+      tFar = t1;
+      farAxis = axis;
+      farSign = -sign;
+    }
+  }
+  if (tNear > tFar || tFar < 0) {
+    return std::nullopt;
+  }
+  auto inside = tNear < 0;
+  if (normal) {
+    *normal = Normalized(MatrixRow(m, inside ? farAxis : nearAxis)) *
+              (inside ? farSign : nearSign);
+  }
+  return inside ? tFar : tNear;
+}
+
 inline std::optional<float> Intersects(const Ray &ray, DirectX::XMMATRIX m) {
   // if (!Ray) {
   //   return {};
@@ -66,32 +135,17 @@ inline std::optional<float> Intersects(const Ray &ray, DirectX::XMMATRIX m) {
       {5, 6, 7, 4}, // z-
   };
 
-  auto origin = DirectX::XMLoadFloat3(&ray.Origin);
-  auto direction = DirectX::XMLoadFloat3(&ray.Direction);
-
-  float closest = std::numeric_limits<float>::infinity();
-  for (int t = 0; t < 6; ++t) {
+  // 12 triangles in two packets, the last 4 lanes degenerate
+  const auto W = kernel::TrianglePacket::WIDTH;
+  kernel::TrianglePacket packets[2];
+  for (uint32_t t = 0; t < 6; ++t) {
     auto [i0, i1, i2, i3] = triangles[t];
-    float dist;
-    if (DirectX::TriangleTests::Intersects(origin, direction,
-                                           DirectX::XMLoadFloat3(&p[i0]), //
-                                           DirectX::XMLoadFloat3(&p[i1]), //
-                                           DirectX::XMLoadFloat3(&p[i2]), //
-                                           dist)) {
-      if (dist < closest) {
-        closest = dist;
-      }
-    } else if (DirectX::TriangleTests::Intersects(
-                   origin, direction,             //
-                   DirectX::XMLoadFloat3(&p[i2]), //
-                   DirectX::XMLoadFloat3(&p[i3]), //
-                   DirectX::XMLoadFloat3(&p[i0]), //
-                   dist)) {
-      if (dist < closest) {
-        closest = dist;
-      }
-    }
+    auto lane = t * 2;
+    packets[lane / W].Set(lane % W, p[i0], p[i1], p[i2]);
+    packets[(lane + 1) / W].Set((lane + 1) % W, p[i2], p[i3], p[i0]);
   }
+  uint32_t index;
+  auto closest = kernel::IntersectsTriangles(ray, packets, &index);
   if (std::isfinite(closest)) {
     return closest;
   } else {
@@ -0,0 +1,138 @@
+#pragma once
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+namespace rectray {
+
+//
+// Static k-d tree over points. Nearest neighbour in O(log n).
+//
+// * implicit: the median of each range is the node, no pointers
+// * split on the axis of the largest extent of the range
+// * ranges of LEAF_SIZE or less are scanned
+//
+class KdTree {
+public:
+  static const uint32_t LEAF_SIZE = 8;
+
+  struct Hit {
+    // in the source points
+    uint32_t Index;
+    DirectX::XMFLOAT3 Point;
+    float Distance;
+  };
+
+private:
+  // tree order
+  std::vector<DirectX::XMFLOAT3> m_points;
+  std::vector<uint32_t> m_indices;
+  // split axis of the node at the median of each range
+  std::vector<uint8_t> m_axes;
+
+  static float Axis(const DirectX::XMFLOAT3 &p, int axis) {
+    return (&p.x)[axis];
+  }
+
+  void Build(std::span<const DirectX::XMFLOAT3> points, uint32_t begin,
+             uint32_t end) {
+    if (end - begin <= LEAF_SIZE) {
+      return;
+    }
+    DirectX::XMFLOAT3 min = points[m_indices[begin]];
+    DirectX::XMFLOAT3 max = min;
+    for (auto i = begin + 1; i < end; ++i) {
+      auto &p = points[m_indices[i]];
+      min = {std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+      max = {std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+    }
+    auto ex = max.x - min.x;
+    auto ey = max.y - min.y;
+    auto ez = max.z - min.z;
+    int axis = ex >= ey && ex >= ez ? 0 : (ey >= ez ? 1 : 2);
+
+    auto mid = (begin + end) / 2;
+    std::nth_element(m_indices.begin() + begin, m_indices.begin() + mid,
+                     m_indices.begin() + end, [&](uint32_t a, uint32_t b) {
+                       return Axis(points[a], axis) < Axis(points[b], axis);
+                     });
+    m_axes[mid] = static_cast<uint8_t>(axis);
+    Build(points, begin, mid);
+    Build(points, mid + 1, end);
+  }
+
+  void Test(uint32_t i, const DirectX::XMFLOAT3 &p, uint32_t *best,
+            float *bestD2) const {
+    auto &q = m_points[i];
+    auto dx = q.x - p.x;
+    auto dy = q.y - p.y;
+    auto dz = q.z - p.z;
+    auto d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 < *bestD2) {
+      *bestD2 = d2;
+      *best = i;
+    }
+  }
+
+  void Search(uint32_t begin, uint32_t end, const DirectX::XMFLOAT3 &p,
+              uint32_t *best, float *bestD2) const {
+    if (end - begin <= LEAF_SIZE) {
+      for (auto i = begin; i < end; ++i) {
+        Test(i, p, best, bestD2);
+      }
+      return;
+    }
+    auto mid = (begin + end) / 2;
+    Test(mid, p, best, bestD2);
+    auto diff = Axis(p, m_axes[mid]) - Axis(m_points[mid], m_axes[mid]);
+    if (diff < 0) {
+      Search(begin, mid, p, best, bestD2);
+      if (diff * diff < *bestD2) {
+        Search(mid + 1, end, p, best, bestD2);
+      }
+    } else {
+      Search(mid + 1, end, p, best, bestD2);
+      if (diff * diff < *bestD2) {
+        Search(begin, mid, p, best, bestD2);
+      }
+    }
+  }
+
+public:
+  KdTree() = default;
+  explicit KdTree(std::span<const DirectX::XMFLOAT3> points) {
+    auto size = static_cast<uint32_t>(points.size());
+    m_indices.resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      m_indices[i] = i;
+    }
+    m_axes.resize(size);
+    Build(points, 0, size);
+    m_points.resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      m_points[i] = points[m_indices[i]];
+    }
+  }
+
+  size_t Size() const { return m_points.size(); }
+  // tree order
+  std::span<const DirectX::XMFLOAT3> Points() const { return m_points; }
+
+  // nearest point closer than maxDistance
+  std::optional<Hit> Nearest(const DirectX::XMFLOAT3 &p,
+                             float maxDistance) const {
+    uint32_t best = UINT32_MAX;
+    float bestD2 = maxDistance * maxDistance;
+    Search(0, static_cast<uint32_t>(m_points.size()), p, &best, &bestD2);
+    if (best == UINT32_MAX) {
+      return std::nullopt;
+    }
+    return Hit{m_indices[best], m_points[best], std::sqrt(bestD2)};
+  }
+};
+
+} // namespace rectray
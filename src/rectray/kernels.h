@@ -0,0 +1,606 @@
+#pragma once
+#include "linearalgebra.h"
+#include <algorithm>
+#include <limits>
+#include <span>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string_view>
+
+// Batch kernels with runtime cpu dispatch.
+//
+// Each kernel is a plain float loop. On x86 with gcc/clang it is compiled
+// once per ISA level (target attribute) and auto-vectorized for that width.
+// The best level is selected on first use from cpuid. It can be forced by
+// SetSimdLevel() or the RECTRAY_SIMD environment variable
+// (none, sse2, avx2, avx512).
+//
+// msvc and non x86 targets only have the baseline level.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RECTRAY_KERNEL_DISPATCH 1
+#define RECTRAY_INLINE inline __attribute__((always_inline))
+#define RECTRAY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define RECTRAY_TARGET_AVX512                                                  \
+  __attribute__((target("avx512f,avx512vl,avx512dq,avx2,fma")))
+#else
+#define RECTRAY_KERNEL_DISPATCH 0
+#define RECTRAY_INLINE inline
+#endif
+
+namespace rectray {
+
+enum class SimdLevel {
+  // compiler baseline on non x86
+  None,
+  SSE2,
+  AVX2,
+  AVX512,
+};
+
+inline const char *SimdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::None:
+    return "none";
+  case SimdLevel::SSE2:
+    return "sse2";
+  case SimdLevel::AVX2:
+    return "avx2";
+  case SimdLevel::AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+inline std::optional<SimdLevel> ParseSimdLevel(std::string_view name) {
+  for (auto level : {SimdLevel::None, SimdLevel::SSE2, SimdLevel::AVX2,
+                     SimdLevel::AVX512}) {
+    if (name == SimdLevelName(level)) {
+      return level;
+    }
+  }
+  return std::nullopt;
+}
+
+// highest level this cpu and build can run
+inline SimdLevel DetectSimdLevel() {
+#if RECTRAY_KERNEL_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("avx512dq")) {
+    return SimdLevel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SimdLevel::AVX2;
+  }
+  return SimdLevel::SSE2;
+#elif defined(_M_X64) || defined(_M_IX86)
+  return SimdLevel::SSE2;
+#else
+  return SimdLevel::None;
+#endif
+}
+
+namespace kernel {
+
+// WIDTH triangles as separate arrays for IntersectsTriangles.
+// v0 and the two edges from it. unused lanes stay degenerate and never hit.
+struct alignas(32) TrianglePacket {
+  static const uint32_t WIDTH = 8;
+  float V0[3][WIDTH] = {};
+  float E1[3][WIDTH] = {};
+  float E2[3][WIDTH] = {};
+
+  void Set(uint32_t lane, const DirectX::XMFLOAT3 &v0,
+           const DirectX::XMFLOAT3 &v1, const DirectX::XMFLOAT3 &v2) {
+    const float *p0 = &v0.x;
+    const float *p1 = &v1.x;
+    const float *p2 = &v2.x;
+    for (int axis = 0; axis < 3; ++axis) {
+      V0[axis][lane] = p0[axis];
+      E1[axis][lane] = p1[axis] - p0[axis];
+      E2[axis][lane] = p2[axis] - p0[axis];
+    }
+  }
+};
+
+// viewport and cursor for CullPoints
+struct PointCull {
+  DirectX::XMFLOAT4X4 ViewProjection;
+  float Width;
+  float Height;
+  // pixels kept outside the viewport. the point radius
+  float Margin;
+  // points at or behind this clip w are dropped
+  float NearW;
+  DirectX::XMFLOAT2 Cursor;
+  // pixels
+  float PickRadius;
+  // optional occlusion (HiZ level 0). a point whose clip w is beyond the
+  // depth of its cell is dropped
+  const float *Depth = nullptr;
+  uint32_t DepthWidth = 0;
+  uint32_t DepthHeight = 0;
+  // viewport pixels per cell
+  float DepthCell = 1;
+};
+
+// CullPoints candidate closest to the cursor
+struct PointPick {
+  // in the source points. UINT32_MAX for none
+  uint32_t Index = UINT32_MAX;
+  // pixels squared
+  float Distance2 = std::numeric_limits<float>::infinity();
+};
+
+//
+// kernel bodies. compiled once per level by the wrappers below.
+//
+
+// ray vs unit cube [-0.5, 0.5] transformed by each matrix.
+// rows 0-2 are the (orthogonal) scaled axes, row 3 the center.
+// writes the ray distance or +inf.
+RECTRAY_INLINE void IntersectsCubesBody(const Ray &ray,
+                                        const DirectX::XMFLOAT4X4 *matrices,
+                                        size_t count, float *hits) {
+  const float INF = std::numeric_limits<float>::infinity();
+  const float ox = ray.Origin.x, oy = ray.Origin.y, oz = ray.Origin.z;
+  const float dx = ray.Direction.x, dy = ray.Direction.y,
+              dz = ray.Direction.z;
+  for (size_t i = 0; i < count; ++i) {
+    auto &m = matrices[i];
+    auto cx = m._41 - ox, cy = m._42 - oy, cz = m._43 - oz;
+    float tNear = -INF;
+    float tFar = INF;
+    for (int axis = 0; axis < 3; ++axis) {
+      auto ax = m.m[axis][0], ay = m.m[axis][1], az = m.m[axis][2];
+      auto inv = 1.0f / (ax * ax + ay * ay + az * az);
+      // box local coordinate along the ray: f * t - e
+      auto e = (ax * cx + ay * cy + az * cz) * inv;
+      auto f = (ax * dx + ay * dy + az * dz) * inv;
+      auto invF = 1.0f / f;
+      auto t0 = (e - 0.5f) * invF;
+      auto t1 = (e + 0.5f) * invF;
+      auto lo = t0 < t1 ? t0 : t1;
+      auto hi = t0 < t1 ? t1 : t0;
+      tNear = lo > tNear ? lo : tNear;
+      tFar = hi < tFar ? hi : tFar;
+    }
+    auto t = tNear >= 0 ? tNear : tFar;
+    hits[i] = (tNear <= tFar && tFar >= 0) ? t : INF;
+  }
+}
+
+// world to viewport with clip w. w <= 0 is behind the camera.
+RECTRAY_INLINE void ProjectPointsBody(const DirectX::XMFLOAT4X4 &m,
+                                      float width, float height,
+                                      const DirectX::XMFLOAT3 *points,
+                                      size_t count, DirectX::XMFLOAT2 *out,
+                                      float *w) {
+  const float hw = width * 0.5f;
+  const float hh = height * 0.5f;
+  for (size_t i = 0; i < count; ++i) {
+    auto &p = points[i];
+    auto cx = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+    auto cy = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+    auto cw = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+    auto inv = 1.0f / cw;
+    out[i].x = (cx * inv + 1.0f) * hw;
+    out[i].y = (1.0f - cy * inv) * hh;
+    w[i] = cw;
+  }
+}
+
+// closest approach of the ray and the segment p0-p1. a is dot(dir, dir).
+// writes the squared distance: sqrtf is a call that sets errno.
+// no division is conditional: a conditional float op keeps gcc from
+// vectorizing the caller's loop (-ftrapping-math).
+RECTRAY_INLINE void SegmentClosest(const Ray &ray, float a,
+                                   const DirectX::XMFLOAT3 &p0,
+                                   const DirectX::XMFLOAT3 &p1,
+                                   float *distance2, float *rayT) {
+  const float dx = ray.Direction.x, dy = ray.Direction.y,
+              dz = ray.Direction.z;
+  auto vx = p1.x - p0.x, vy = p1.y - p0.y, vz = p1.z - p0.z;
+  auto wx = ray.Origin.x - p0.x, wy = ray.Origin.y - p0.y,
+       wz = ray.Origin.z - p0.z;
+  auto b = dx * vx + dy * vy + dz * vz;
+  auto c = vx * vx + vy * vy + vz * vz;
+  auto d = dx * wx + dy * wy + dz * wz;
+  auto e = vx * wx + vy * wy + vz * wz;
+  auto den = a * c - b * b;
+  // parallel: start from the segment start. the upper bound of the clamp
+  // drops to 0 rather than selecting u, which gcc does not if-convert
+  auto u = (a * e - b * d) / std::max(den, 1e-8f);
+  u = std::min(std::max(u, 0.0f), den > 1e-8f ? 1.0f : 0.0f);
+  auto s = std::max((b * u - d) / a, 0.0f);
+  u = (b * s + e) / std::max(c, 1e-30f);
+  u = std::min(std::max(u, 0.0f), c > 0 ? 1.0f : 0.0f);
+  auto x = wx + dx * s - vx * u;
+  auto y = wy + dy * s - vy * u;
+  auto z = wz + dz * s - vz * u;
+  *distance2 = x * x + y * y + z * z;
+  *rayT = s;
+}
+
+// closest approach of the ray and segments p0-p1.
+// writes the world distance and the ray parameter at the closest point.
+RECTRAY_INLINE void SegmentDistancesBody(const Ray &ray,
+                                         const DirectX::XMFLOAT3 *p0,
+                                         const DirectX::XMFLOAT3 *p1,
+                                         size_t count, float *distances,
+                                         float *rayT) {
+  // a copy: the outputs could alias the ray
+  const Ray r = ray;
+  const float a = Dot(r.Direction, r.Direction);
+  for (size_t i = 0; i < count; ++i) {
+    SegmentClosest(r, a, p0[i], p1[i], &distances[i], &rayT[i]);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    distances[i] = sqrtf(distances[i]);
+  }
+}
+
+// line handles. a segment is hit when the ray passes within pixels[i] of
+// it, measured at the depth of the closest point: pixels * rayT * scale.
+// scale is the world length of a pixel per unit ray distance
+// (Context::RayPixelScale). writes the ray distance or +inf.
+RECTRAY_INLINE void IntersectsSegmentsBody(const Ray &ray,
+                                           const DirectX::XMFLOAT3 *p0,
+                                           const DirectX::XMFLOAT3 *p1,
+                                           const float *pixels, size_t count,
+                                           float scale, float *hits) {
+  const float INF = std::numeric_limits<float>::infinity();
+  const Ray r = ray;
+  const float a = Dot(r.Direction, r.Direction);
+  for (size_t i = 0; i < count; ++i) {
+    float distance2;
+    float s;
+    SegmentClosest(r, a, p0[i], p1[i], &distance2, &s);
+    auto tolerance = pixels[i] * s * scale;
+    hits[i] = distance2 <= tolerance * tolerance ? s : INF;
+  }
+}
+
+// world to viewport, keeping points in front of NearW, inside the
+// viewport grown by Margin and not behind Depth. the kept points are packed
+// to the front of out. returns the kept count.
+// blocks of BLOCK: a vectorizable projection pass, then a branch free
+// packing pass. a conditional float op in the first pass keeps gcc from
+// vectorizing it (-ftrapping-math), so the flag is stored separately.
+RECTRAY_INLINE size_t CullPointsBody(const PointCull &c,
+                                     const DirectX::XMFLOAT3 *points,
+                                     size_t count, DirectX::XMFLOAT2 *out,
+                                     PointPick *pick) {
+  const size_t BLOCK = 256;
+  auto &m = c.ViewProjection;
+  const float hw = c.Width * 0.5f;
+  const float hh = c.Height * 0.5f;
+  const float x0 = -c.Margin, x1 = c.Width + c.Margin;
+  const float y0 = -c.Margin, y1 = c.Height + c.Margin;
+  float best = c.PickRadius * c.PickRadius;
+  uint32_t bestIndex = UINT32_MAX;
+  size_t kept = 0;
+  float xs[BLOCK];
+  float ys[BLOCK];
+  float d2s[BLOCK];
+  float ws[BLOCK];
+  int32_t keeps[BLOCK];
+  for (size_t begin = 0; begin < count; begin += BLOCK) {
+    auto size = count - begin < BLOCK ? count - begin : BLOCK;
+    auto block = points + begin;
+    for (size_t i = 0; i < size; ++i) {
+      auto &p = block[i];
+      auto cx = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+      auto cy = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+      auto cw = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+      auto inv = 1.0f / cw;
+      auto x = (cx * inv + 1.0f) * hw;
+      auto y = (1.0f - cy * inv) * hh;
+      auto dx = x - c.Cursor.x;
+      auto dy = y - c.Cursor.y;
+      xs[i] = x;
+      ys[i] = y;
+      d2s[i] = dx * dx + dy * dy;
+      ws[i] = cw;
+      keeps[i] = (cw > c.NearW) & (x >= x0) & (x <= x1) & (y >= y0) & (y <= y1);
+    }
+    if (c.Depth) {
+      const float inv = 1.0f / c.DepthCell;
+      for (size_t i = 0; i < size; ++i) {
+        if (keeps[i]) {
+          // inside the viewport grown by the margin. clamp to the grid
+          auto cx = std::clamp(static_cast<int32_t>(xs[i] * inv), 0,
+                               static_cast<int32_t>(c.DepthWidth) - 1);
+          auto cy = std::clamp(static_cast<int32_t>(ys[i] * inv), 0,
+                               static_cast<int32_t>(c.DepthHeight) - 1);
+          keeps[i] = ws[i] <= c.Depth[cy * c.DepthWidth + cx];
+        }
+      }
+    }
+    for (size_t i = 0; i < size; ++i) {
+      // the store always happens. kept advances only for a kept point
+      out[kept] = {xs[i], ys[i]};
+      kept += keeps[i];
+      bool closer = keeps[i] & (d2s[i] < best);
+      best = closer ? d2s[i] : best;
+      bestIndex = closer ? static_cast<uint32_t>(begin + i) : bestIndex;
+    }
+  }
+  if (bestIndex != UINT32_MAX) {
+    *pick = {bestIndex, best};
+  } else {
+    *pick = {};
+  }
+  return kept;
+}
+
+// ray vs every lane of the packets, two sided (Moller-Trumbore).
+// returns the closest ray parameter or +inf, and its packet * WIDTH + lane.
+RECTRAY_INLINE float IntersectsTrianglesBody(const Ray &ray,
+                                             const TrianglePacket *packets,
+                                             size_t count, uint32_t *index) {
+  const float INF = std::numeric_limits<float>::infinity();
+  const uint32_t W = TrianglePacket::WIDTH;
+  const float ox = ray.Origin.x, oy = ray.Origin.y, oz = ray.Origin.z;
+  const float dx = ray.Direction.x, dy = ray.Direction.y,
+              dz = ray.Direction.z;
+  float closest = INF;
+  uint32_t closestIndex = UINT32_MAX;
+  for (size_t k = 0; k < count; ++k) {
+    auto &p = packets[k];
+    float t[W];
+    // branch free over the lanes
+    for (uint32_t i = 0; i < W; ++i) {
+      auto e1x = p.E1[0][i], e1y = p.E1[1][i], e1z = p.E1[2][i];
+      auto e2x = p.E2[0][i], e2y = p.E2[1][i], e2z = p.E2[2][i];
+      auto px = dy * e2z - dz * e2y;
+      auto py = dz * e2x - dx * e2z;
+      auto pz = dx * e2y - dy * e2x;
+      auto det = e1x * px + e1y * py + e1z * pz;
+      auto inv = 1.0f / det;
+      auto sx = ox - p.V0[0][i], sy = oy - p.V0[1][i], sz = oz - p.V0[2][i];
+      auto u = (sx * px + sy * py + sz * pz) * inv;
+      auto qx = sy * e1z - sz * e1y;
+      auto qy = sz * e1x - sx * e1z;
+      auto qz = sx * e1y - sy * e1x;
+      auto v = (dx * qx + dy * qy + dz * qz) * inv;
+      auto d = (e2x * qx + e2y * qy + e2z * qz) * inv;
+      auto hit = (fabsf(det) > 1e-12f) & (u >= 0) & (v >= 0) &
+                 (u + v <= 1) & (d >= 0);
+      t[i] = hit ? d : INF;
+    }
+    for (uint32_t i = 0; i < W; ++i) {
+      if (t[i] < closest) {
+        closest = t[i];
+        closestIndex = static_cast<uint32_t>(k * W + i);
+      }
+    }
+  }
+  *index = closestIndex;
+  return closest;
+}
+
+// thick lines to quads. 4 corners per line, clockwise from p0.
+RECTRAY_INLINE void ExpandLinesBody(const DirectX::XMFLOAT2 *p0,
+                                    const DirectX::XMFLOAT2 *p1, size_t count,
+                                    float thickness, DirectX::XMFLOAT2 *quads) {
+  const float half = thickness * 0.5f;
+  for (size_t i = 0; i < count; ++i) {
+    auto dx = p1[i].x - p0[i].x;
+    auto dy = p1[i].y - p0[i].y;
+    auto len2 = dx * dx + dy * dy;
+    auto f = half / sqrtf(len2 > 1e-12f ? len2 : 1e-12f);
+    auto nx = -dy * f;
+    auto ny = dx * f;
+    auto q = quads + i * 4;
+    q[0] = {p0[i].x + nx, p0[i].y + ny};
+    q[1] = {p1[i].x + nx, p1[i].y + ny};
+    q[2] = {p1[i].x - nx, p1[i].y - ny};
+    q[3] = {p0[i].x - nx, p0[i].y - ny};
+  }
+}
+
+struct KernelTable {
+  SimdLevel Level;
+  void (*IntersectsCubes)(const Ray &, const DirectX::XMFLOAT4X4 *, size_t,
+                          float *);
+  void (*ProjectPoints)(const DirectX::XMFLOAT4X4 &, float, float,
+                        const DirectX::XMFLOAT3 *, size_t, DirectX::XMFLOAT2 *,
+                        float *);
+  void (*SegmentDistances)(const Ray &, const DirectX::XMFLOAT3 *,
+                           const DirectX::XMFLOAT3 *, size_t, float *,
+                           float *);
+  void (*ExpandLines)(const DirectX::XMFLOAT2 *, const DirectX::XMFLOAT2 *,
+                      size_t, float, DirectX::XMFLOAT2 *);
+  float (*IntersectsTriangles)(const Ray &, const TrianglePacket *, size_t,
+                               uint32_t *);
+  size_t (*CullPoints)(const PointCull &, const DirectX::XMFLOAT3 *, size_t,
+                       DirectX::XMFLOAT2 *, PointPick *);
+  void (*IntersectsSegments)(const Ray &, const DirectX::XMFLOAT3 *,
+                             const DirectX::XMFLOAT3 *, const float *, size_t,
+                             float, float *);
+};
+
+#define RECTRAY_KERNEL_TABLE(NAME, TARGET)                                     \
+  struct NAME {                                                                \
+    TARGET static void IntersectsCubes(const Ray &ray,                         \
+                                       const DirectX::XMFLOAT4X4 *m, size_t n, \
+                                       float *hits) {                          \
+      IntersectsCubesBody(ray, m, n, hits);                                    \
+    }                                                                          \
+    TARGET static void ProjectPoints(const DirectX::XMFLOAT4X4 &m, float w,    \
+                                     float h, const DirectX::XMFLOAT3 *p,      \
+                                     size_t n, DirectX::XMFLOAT2 *out,         \
+                                     float *clipW) {                           \
+      ProjectPointsBody(m, w, h, p, n, out, clipW);                            \
+    }                                                                          \
+    TARGET static void SegmentDistances(const Ray &ray,                        \
+                                        const DirectX::XMFLOAT3 *p0,           \
+                                        const DirectX::XMFLOAT3 *p1, size_t n, \
+                                        float *d, float *t) {                  \
+      SegmentDistancesBody(ray, p0, p1, n, d, t);                              \
+    }                                                                          \
+    TARGET static void ExpandLines(const DirectX::XMFLOAT2 *p0,                \
+                                   const DirectX::XMFLOAT2 *p1, size_t n,      \
+                                   float thickness, DirectX::XMFLOAT2 *q) {    \
+      ExpandLinesBody(p0, p1, n, thickness, q);                                \
+    }                                                                          \
+    TARGET static float IntersectsTriangles(const Ray &ray,                    \
+                                            const TrianglePacket *p, size_t n, \
+                                            uint32_t *index) {                 \
+      return IntersectsTrianglesBody(ray, p, n, index);                        \
+    }                                                                          \
+    TARGET static size_t CullPoints(const PointCull &c,                        \
+                                    const DirectX::XMFLOAT3 *p, size_t n,      \
+                                    DirectX::XMFLOAT2 *out, PointPick *pick) { \
+      return CullPointsBody(c, p, n, out, pick);                               \
+    }                                                                          \
+    TARGET static void IntersectsSegments(                                     \
+        const Ray &ray, const DirectX::XMFLOAT3 *p0,                           \
+        const DirectX::XMFLOAT3 *p1, const float *pixels, size_t n,            \
+        float scale, float *hits) {                                            \
+      IntersectsSegmentsBody(ray, p0, p1, pixels, n, scale, hits);             \
+    }                                                                          \
+  };
+
+RECTRAY_KERNEL_TABLE(BaselineKernels, )
+#if RECTRAY_KERNEL_DISPATCH
+RECTRAY_KERNEL_TABLE(Avx2Kernels, RECTRAY_TARGET_AVX2)
+RECTRAY_KERNEL_TABLE(Avx512Kernels, RECTRAY_TARGET_AVX512)
+#endif
+#undef RECTRAY_KERNEL_TABLE
+
+template <typename T> KernelTable MakeKernelTable(SimdLevel level) {
+  return {
+      level,
+      &T::IntersectsCubes,
+      &T::ProjectPoints,
+      &T::SegmentDistances,
+      &T::ExpandLines,
+      &T::IntersectsTriangles,
+      &T::CullPoints,
+      &T::IntersectsSegments,
+  };
+}
+
+// highest compiled table not above level
+inline KernelTable SelectKernels(SimdLevel level) {
+  auto supported = DetectSimdLevel();
+  if (level > supported) {
+    level = supported;
+  }
+#if RECTRAY_KERNEL_DISPATCH
+  if (level >= SimdLevel::AVX512) {
+    return MakeKernelTable<Avx512Kernels>(SimdLevel::AVX512);
+  }
+  if (level >= SimdLevel::AVX2) {
+    return MakeKernelTable<Avx2Kernels>(SimdLevel::AVX2);
+  }
+#endif
+  // baseline is all the build has
+  return MakeKernelTable<BaselineKernels>(supported < SimdLevel::SSE2
+                                              ? supported
+                                              : SimdLevel::SSE2);
+}
+
+inline KernelTable &CurrentKernels() {
+  static KernelTable s_table = []() {
+    auto level = DetectSimdLevel();
+    if (auto env = getenv("RECTRAY_SIMD")) {
+      if (auto forced = ParseSimdLevel(env)) {
+        level = *forced;
+      }
+    }
+    return SelectKernels(level);
+  }();
+  return s_table;
+}
+
+//
+// dispatched entry points
+//
+
+inline void IntersectsCubes(const Ray &ray,
+                            std::span<const DirectX::XMFLOAT4X4> matrices,
+                            std::span<float> hits) {
+  assert(hits.size() >= matrices.size());
+  CurrentKernels().IntersectsCubes(ray, matrices.data(), matrices.size(),
+                                   hits.data());
+}
+
+inline void ProjectPoints(const DirectX::XMFLOAT4X4 &viewProjection,
+                          float width, float height,
+                          std::span<const DirectX::XMFLOAT3> points,
+                          std::span<DirectX::XMFLOAT2> out,
+                          std::span<float> w) {
+  assert(out.size() >= points.size());
+  assert(w.size() >= points.size());
+  CurrentKernels().ProjectPoints(viewProjection, width, height, points.data(),
+                                 points.size(), out.data(), w.data());
+}
+
+inline void SegmentDistances(const Ray &ray,
+                             std::span<const DirectX::XMFLOAT3> p0,
+                             std::span<const DirectX::XMFLOAT3> p1,
+                             std::span<float> distances,
+                             std::span<float> rayT) {
+  assert(p1.size() == p0.size());
+  assert(distances.size() >= p0.size());
+  assert(rayT.size() >= p0.size());
+  CurrentKernels().SegmentDistances(ray, p0.data(), p1.data(), p0.size(),
+                                    distances.data(), rayT.data());
+}
+
+inline void ExpandLines(std::span<const DirectX::XMFLOAT2> p0,
+                        std::span<const DirectX::XMFLOAT2> p1, float thickness,
+                        std::span<DirectX::XMFLOAT2> quads) {
+  assert(p1.size() == p0.size());
+  assert(quads.size() >= p0.size() * 4);
+  CurrentKernels().ExpandLines(p0.data(), p1.data(), p0.size(), thickness,
+                               quads.data());
+}
+
+// closest hit over all lanes, or +inf. index is packet * WIDTH + lane
+inline float IntersectsTriangles(const Ray &ray,
+                                 std::span<const TrianglePacket> packets,
+                                 uint32_t *index) {
+  return CurrentKernels().IntersectsTriangles(ray, packets.data(),
+                                              packets.size(), index);
+}
+
+// ray distance of each segment hit within its pixel tolerance, or +inf
+inline void IntersectsSegments(const Ray &ray,
+                               std::span<const DirectX::XMFLOAT3> p0,
+                               std::span<const DirectX::XMFLOAT3> p1,
+                               std::span<const float> pixels, float scale,
+                               std::span<float> hits) {
+  assert(p1.size() == p0.size());
+  assert(pixels.size() == p0.size());
+  assert(hits.size() >= p0.size());
+  CurrentKernels().IntersectsSegments(ray, p0.data(), p1.data(),
+                                      pixels.data(), p0.size(), scale,
+                                      hits.data());
+}
+
+// kept points packed into out. returns the kept count
+inline size_t CullPoints(const PointCull &cull,
+                         std::span<const DirectX::XMFLOAT3> points,
+                         std::span<DirectX::XMFLOAT2> out, PointPick *pick) {
+  assert(out.size() >= points.size());
+  return CurrentKernels().CullPoints(cull, points.data(), points.size(),
+                                     out.data(), pick);
+}
+
+} // namespace kernel
+
+inline SimdLevel GetSimdLevel() { return kernel::CurrentKernels().Level; }
+
+// force a level for benchmark and test. clamped to what the cpu supports.
+// call before kernels run on other threads.
+inline SimdLevel SetSimdLevel(SimdLevel level) {
+  kernel::CurrentKernels() = kernel::SelectKernels(level);
+  return GetSimdLevel();
+}
+
+} // namespace rectray
@@ -0,0 +1,194 @@
+#pragma once
+#include "drawlist.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <math.h>
+#include <span>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+namespace rectray {
+
+//
+// Screen space label placement. a label that would overlap one of higher
+// priority is dropped, so thousands of labels stay readable and only the
+// placed ones reach the DrawList.
+//
+// * in priority order each label tries the corners around its anchor:
+//   right below, right above, left below, left above. the first free one
+//   that fits the viewport wins
+// * placed labels are kept in a uniform grid of CELL pixels. a candidate is
+//   tested only against the labels in the cells it covers, O(1) expected.
+//   the sort by priority is the only part above O(n)
+//
+class LabelLayout {
+public:
+  static const uint32_t CELL = 32;
+
+  struct Label {
+    // viewport coordinates
+    DirectX::XMFLOAT2 Anchor;
+    // pixels
+    DirectX::XMFLOAT2 Size;
+    // higher first
+    float Priority = 0;
+    // lower first on equal priority. the view depth of a world label
+    float Depth = 0;
+    uint32_t Color = 0xFFFFFFFF;
+    // valid until the DrawList of Emit() is cleared
+    std::string_view Text;
+  };
+
+  struct Placement {
+    // top left
+    DirectX::XMFLOAT2 Pos;
+    // index of Add()
+    uint32_t Label;
+  };
+
+  // pixels kept free between two labels
+  float Padding = 2;
+  // pixels between the anchor and its label
+  float Offset = 4;
+
+private:
+  std::vector<Label> m_labels;
+  std::vector<uint32_t> m_order;
+  std::vector<Placement> m_placed;
+  struct Rect {
+    float X0;
+    float Y0;
+    float X1;
+    float Y1;
+  };
+  std::vector<Rect> m_rects;
+  // first entry of each cell, -1 for none. entries of a cell chain by Next
+  std::vector<int32_t> m_cells;
+  struct Entry {
+    uint32_t Rect;
+    int32_t Next;
+  };
+  std::vector<Entry> m_entries;
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+
+  // cells [x0, x1] x [y0, y1] covered by r, clamped to the grid
+  void CellRange(const Rect &r, uint32_t *x0, uint32_t *y0, uint32_t *x1,
+                 uint32_t *y1) const {
+    *x0 = std::min(static_cast<uint32_t>(std::max(r.X0, 0.f)) / CELL,
+                   m_width - 1);
+    *y0 = std::min(static_cast<uint32_t>(std::max(r.Y0, 0.f)) / CELL,
+                   m_height - 1);
+    *x1 = std::min(static_cast<uint32_t>(std::max(r.X1, 0.f)) / CELL,
+                   m_width - 1);
+    *y1 = std::min(static_cast<uint32_t>(std::max(r.Y1, 0.f)) / CELL,
+                   m_height - 1);
+  }
+
+  bool Free(const Rect &r) const {
+    Rect padded{r.X0 - Padding, r.Y0 - Padding, r.X1 + Padding,
+                r.Y1 + Padding};
+    uint32_t x0, y0, x1, y1;
+    CellRange(padded, &x0, &y0, &x1, &y1);
+    for (auto y = y0; y <= y1; ++y) {
+      for (auto x = x0; x <= x1; ++x) {
+        for (auto e = m_cells[y * m_width + x]; e >= 0;
+             e = m_entries[e].Next) {
+          auto &o = m_rects[m_entries[e].Rect];
+          if (padded.X0 < o.X1 && o.X0 < padded.X1 && padded.Y0 < o.Y1 &&
+              o.Y0 < padded.Y1) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  void Insert(const Rect &r) {
+    auto index = static_cast<uint32_t>(m_rects.size());
+    m_rects.push_back(r);
+    uint32_t x0, y0, x1, y1;
+    CellRange(r, &x0, &y0, &x1, &y1);
+    for (auto y = y0; y <= y1; ++y) {
+      for (auto x = x0; x <= x1; ++x) {
+        auto &head = m_cells[y * m_width + x];
+        m_entries.push_back({index, head});
+        head = static_cast<int32_t>(m_entries.size() - 1);
+      }
+    }
+  }
+
+public:
+  void Clear() {
+    m_labels.clear();
+    m_placed.clear();
+  }
+  bool Empty() const { return m_labels.empty(); }
+  // labels added since Clear()
+  size_t Size() const { return m_labels.size(); }
+  std::span<const Label> Labels() const { return m_labels; }
+  // result of the last Layout(), in priority order
+  std::span<const Placement> Placed() const { return m_placed; }
+
+  void Add(const Label &label) { m_labels.push_back(label); }
+
+  // place the labels in a viewport of width x height pixels
+  std::span<const Placement> Layout(float width, float height) {
+    m_placed.clear();
+    m_rects.clear();
+    m_entries.clear();
+    m_width = std::max(static_cast<uint32_t>(ceilf(width / CELL)), 1u);
+    m_height = std::max(static_cast<uint32_t>(ceilf(height / CELL)), 1u);
+    m_cells.assign(m_width * m_height, -1);
+
+    m_order.resize(m_labels.size());
+    for (uint32_t i = 0; i < m_order.size(); ++i) {
+      m_order[i] = i;
+    }
+    std::stable_sort(m_order.begin(), m_order.end(),
+                     [&labels = m_labels](uint32_t a, uint32_t b) {
+                       if (labels[a].Priority != labels[b].Priority) {
+                         return labels[a].Priority > labels[b].Priority;
+                       }
+                       return labels[a].Depth < labels[b].Depth;
+                     });
+
+    for (auto i : m_order) {
+      auto &label = m_labels[i];
+      auto a = label.Anchor;
+      auto w = label.Size.x;
+      auto h = label.Size.y;
+      DirectX::XMFLOAT2 corners[] = {
+          {a.x + Offset, a.y + Offset},
+          {a.x + Offset, a.y - Offset - h},
+          {a.x - Offset - w, a.y + Offset},
+          {a.x - Offset - w, a.y - Offset - h},
+      };
+      for (auto &p : corners) {
+        Rect r{p.x, p.y, p.x + w, p.y + h};
+        if (r.X0 < 0 || r.Y0 < 0 || r.X1 > width || r.Y1 > height) {
+          continue;
+        }
+        if (Free(r)) {
+          Insert(r);
+          m_placed.push_back({p, i});
+          break;
+        }
+      }
+    }
+    return m_placed;
+  }
+
+  // the placed labels of the last Layout() as marker::Text
+  void Emit(DrawList *drawlist) const {
+    for (auto &placed : m_placed) {
+      auto &label = m_labels[placed.Label];
+      drawlist->AddText(placed.Pos, label.Color, label.Text,
+                        TextStorage::External);
+    }
+  }
+};
+
+} // namespace rectray
@@ -1,8 +1,13 @@
 #pragma once
 
 #ifdef __EMSCRIPTEN__
+#if defined(__wasm_simd128__) && defined(__SSE2__)
+// -msimd128 -msse2: emscripten lowers the SSE intrinsics to wasm simd128
+#define _XM_SSE_INTRINSICS_
+#else
 #define _XM_NO_INTRINSICS_
 #endif
+#endif
 #include <DirectXCollision.h>
 #include <DirectXMath.h>
 #include <algorithm>
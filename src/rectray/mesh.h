@@ -0,0 +1,201 @@
+#pragma once
+#include "bvh.h"
+#include "kernels.h"
+#include <memory>
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+namespace rectray {
+
+// two sided. the ray parameter or nullopt (Moller-Trumbore)
+inline std::optional<float> IntersectsTriangle(const Ray &ray,
+                                               const DirectX::XMFLOAT3 &v0,
+                                               const DirectX::XMFLOAT3 &v1,
+                                               const DirectX::XMFLOAT3 &v2) {
+  auto e1 = v1 - v0;
+  auto e2 = v2 - v0;
+  auto p = Cross(ray.Direction, e2);
+  auto det = Dot(e1, p);
+  if (std::abs(det) < 1e-12f) {
+    return std::nullopt;
+  }
+  auto inv = 1.0f / det;
+  auto s = ray.Origin - v0;
+  auto u = Dot(s, p) * inv;
+  if (u < 0 || u > 1) {
+    return std::nullopt;
+  }
+  auto q = Cross(s, e1);
+  auto v = Dot(ray.Direction, q) * inv;
+  if (v < 0 || u + v > 1) {
+    return std::nullopt;
+  }
+  auto t = Dot(e2, q) * inv;
+  if (t < 0) {
+    return std::nullopt;
+  }
+  return t;
+}
+
+//
+// Indexed triangles for picking, shared by every instance.
+//
+// * Vertices and Indices are not copied. keep them alive with the mesh
+// * the bvh over the triangles is built once in Create()
+// * each bvh leaf is one TrianglePacket, tested in one kernel call
+// * Edges know their two faces for silhouette emission
+//
+class TriangleMesh {
+public:
+  struct Edge {
+    uint32_t V0;
+    uint32_t V1;
+    uint32_t F0;
+    // BOUNDARY for an open edge
+    uint32_t F1;
+  };
+  static const uint32_t BOUNDARY = UINT32_MAX;
+
+  std::span<const DirectX::XMFLOAT3> Vertices;
+  std::span<const uint32_t> Indices;
+
+private:
+  Bvh m_bvh;
+  // bvh leaf order. Indices()[begin] is in m_packets[begin / WIDTH]
+  std::vector<kernel::TrianglePacket> m_packets;
+  Aabb m_bounds;
+  std::vector<Edge> m_edges;
+  // not normalized
+  std::vector<DirectX::XMFLOAT3> m_faceNormals;
+
+  void BuildEdges() {
+    auto faces = static_cast<uint32_t>(Indices.size() / 3);
+    // (min vertex << 32 | max vertex, face)
+    std::vector<std::pair<uint64_t, uint32_t>> halfEdges;
+    halfEdges.reserve(faces * 3);
+    for (uint32_t f = 0; f < faces; ++f) {
+      for (int i = 0; i < 3; ++i) {
+        uint64_t a = Indices[f * 3 + i];
+        uint64_t b = Indices[f * 3 + (i + 1) % 3];
+        halfEdges.push_back({a < b ? a << 32 | b : b << 32 | a, f});
+      }
+    }
+    std::sort(halfEdges.begin(), halfEdges.end());
+    for (size_t i = 0; i < halfEdges.size();) {
+      auto [key, f0] = halfEdges[i];
+      auto f1 = BOUNDARY;
+      size_t j = i + 1;
+      if (j < halfEdges.size() && halfEdges[j].first == key) {
+        f1 = halfEdges[j].second;
+      }
+      // skip the rest of a non manifold edge
+      while (j < halfEdges.size() && halfEdges[j].first == key) {
+        ++j;
+      }
+      m_edges.push_back({static_cast<uint32_t>(key >> 32),
+                         static_cast<uint32_t>(key), f0, f1});
+      i = j;
+    }
+  }
+
+public:
+  static std::shared_ptr<const TriangleMesh>
+  Create(std::span<const DirectX::XMFLOAT3> vertices,
+         std::span<const uint32_t> indices) {
+    auto mesh = std::make_shared<TriangleMesh>();
+    mesh->Vertices = vertices;
+    mesh->Indices = indices;
+
+    auto faces = indices.size() / 3;
+    std::vector<Aabb> boxes(faces);
+    mesh->m_faceNormals.resize(faces);
+    for (size_t f = 0; f < faces; ++f) {
+      auto &v0 = vertices[indices[f * 3]];
+      auto &v1 = vertices[indices[f * 3 + 1]];
+      auto &v2 = vertices[indices[f * 3 + 2]];
+      boxes[f].Extend(v0);
+      boxes[f].Extend(v1);
+      boxes[f].Extend(v2);
+      mesh->m_bounds.Extend(boxes[f]);
+      mesh->m_faceNormals[f] = Cross(v1 - v0, v2 - v0);
+    }
+    mesh->m_bvh = Bvh(boxes, kernel::TrianglePacket::WIDTH);
+    auto order = mesh->m_bvh.Indices();
+    mesh->m_packets.resize((faces + kernel::TrianglePacket::WIDTH - 1) /
+                           kernel::TrianglePacket::WIDTH);
+    for (size_t i = 0; i < order.size(); ++i) {
+      auto f = order[i];
+      mesh->m_packets[i / kernel::TrianglePacket::WIDTH].Set(
+          i % kernel::TrianglePacket::WIDTH, vertices[indices[f * 3]],
+          vertices[indices[f * 3 + 1]], vertices[indices[f * 3 + 2]]);
+    }
+    mesh->BuildEdges();
+    return mesh;
+  }
+
+  size_t TriangleCount() const { return Indices.size() / 3; }
+  const Aabb &Bounds() const { return m_bounds; }
+  std::span<const Edge> Edges() const { return m_edges; }
+
+  // ray in mesh space. closest triangle and its ray parameter
+  std::optional<Bvh::Hit> Raycast(const Ray &local) const {
+    return m_bvh.RaycastLeaves(
+        local,
+        [this](uint32_t begin, uint32_t, const Ray &ray,
+               float closest) -> std::optional<Bvh::Hit> {
+          auto packet = begin / kernel::TrianglePacket::WIDTH;
+          assert(begin % kernel::TrianglePacket::WIDTH == 0);
+          uint32_t lane;
+          auto t = kernel::IntersectsTriangles(
+              ray, std::span(m_packets).subspan(packet, 1), &lane);
+          if (t >= closest) {
+            return std::nullopt;
+          }
+          return Bvh::Hit{m_bvh.Indices()[begin + lane], t};
+        });
+  }
+
+  // world ray against the instance at matrix. world distance
+  std::optional<float> Intersects(const Ray &ray,
+                                  const DirectX::XMFLOAT4X4 &matrix) const {
+    auto inv =
+        DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&matrix));
+    // not normalized, so the ray parameter stays the world distance
+    Ray local;
+    DirectX::XMStoreFloat3(
+        &local.Origin,
+        DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&ray.Origin), inv));
+    DirectX::XMStoreFloat3(&local.Direction,
+                           DirectX::XMVector3TransformNormal(
+                               DirectX::XMLoadFloat3(&ray.Direction), inv));
+    if (auto hit = Raycast(local)) {
+      return hit->Distance;
+    }
+    return std::nullopt;
+  }
+
+  bool FrontFacing(uint32_t face, const DirectX::XMFLOAT3 &eye) const {
+    return Dot(m_faceNormals[face], eye - Vertices[Indices[face * 3]]) > 0;
+  }
+
+  // edges between a front and a back face, and open edges.
+  // eye in mesh space
+  void SilhouetteEdges(const DirectX::XMFLOAT3 &eye,
+                       std::vector<uint32_t> *out) const {
+    // once per face, not twice per edge
+    std::vector<uint8_t> front(TriangleCount());
+    for (uint32_t f = 0; f < front.size(); ++f) {
+      front[f] = FrontFacing(f, eye);
+    }
+    out->clear();
+    for (uint32_t i = 0; i < m_edges.size(); ++i) {
+      auto &e = m_edges[i];
+      if (e.F1 == BOUNDARY || front[e.F0] != front[e.F1]) {
+        out->push_back(i);
+      }
+    }
+  }
+};
+
+} // namespace rectray
@@ -0,0 +1,162 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+// wasm without -pthread. everything runs on the calling thread
+#define RECTRAY_THREADS 0
+#else
+#define RECTRAY_THREADS 1
+#include <thread>
+#endif
+
+namespace rectray {
+
+//
+// Threads kept for the frames, so a parallel loop does not start any.
+//
+// * Threads() counts the caller. SetThreads(n) keeps n - 1 workers
+// * Run() wakes the workers with one atomic job counter and waits on
+//   another for the rest. no lock, as FramePipeline
+// * one Run() at a time. the caller runs chunk 0 itself
+//
+// Without threads (wasm without -pthread) Threads() is always 1.
+//
+class WorkerPool {
+  // job id, incremented by Run(). STOP ends the workers
+  std::atomic<uint32_t> m_job{0};
+  // workers still busy with the job
+  std::atomic<uint32_t> m_busy{0};
+  uint32_t m_chunks = 0;
+  void (*m_run)(const void *, uint32_t) = nullptr;
+  const void *m_f = nullptr;
+#if RECTRAY_THREADS
+  static constexpr uint32_t STOP = UINT32_MAX;
+  std::vector<std::thread> m_workers;
+
+  void Loop(uint32_t chunk) {
+    uint32_t seen = 0;
+    while (true) {
+      m_job.wait(seen, std::memory_order_acquire);
+      seen = m_job.load(std::memory_order_acquire);
+      if (seen == STOP) {
+        return;
+      }
+      if (chunk < m_chunks) {
+        m_run(m_f, chunk);
+      }
+      if (m_busy.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_busy.notify_all();
+      }
+    }
+  }
+
+  void Stop() {
+    if (m_workers.empty()) {
+      return;
+    }
+    m_job.store(STOP, std::memory_order_release);
+    m_job.notify_all();
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+    m_workers.clear();
+    m_job.store(0, std::memory_order_relaxed);
+  }
+#endif
+
+public:
+  explicit WorkerPool(uint32_t threads = 1) { SetThreads(threads); }
+  ~WorkerPool() {
+#if RECTRAY_THREADS
+    Stop();
+#endif
+  }
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  uint32_t Threads() const {
+#if RECTRAY_THREADS
+    return static_cast<uint32_t>(m_workers.size()) + 1;
+#else
+    return 1;
+#endif
+  }
+
+  // starts or stops workers only when the count changes
+  void SetThreads(uint32_t threads) {
+#if RECTRAY_THREADS
+    threads = std::max(threads, 1u);
+    if (threads == Threads()) {
+      return;
+    }
+    Stop();
+    for (uint32_t i = 1; i < threads; ++i) {
+      m_workers.emplace_back([this, i]() { Loop(i); });
+    }
+#endif
+  }
+
+  // f(chunk) for chunk in [0, chunks), chunks <= Threads(). returns when
+  // all are done
+  template <typename F> void Run(uint32_t chunks, const F &f) {
+#if RECTRAY_THREADS
+    if (chunks > 1) {
+      m_chunks = chunks;
+      m_f = &f;
+      m_run = [](const void *p, uint32_t chunk) {
+        (*static_cast<const F *>(p))(chunk);
+      };
+      // every worker takes part, idle ones return at once
+      m_busy.store(static_cast<uint32_t>(m_workers.size()),
+                   std::memory_order_relaxed);
+      auto job = m_job.load(std::memory_order_relaxed) + 1;
+      m_job.store(job == STOP ? 1 : job, std::memory_order_release);
+      m_job.notify_all();
+      f(0u);
+      while (true) {
+        auto busy = m_busy.load(std::memory_order_acquire);
+        if (busy == 0) {
+          return;
+        }
+        m_busy.wait(busy, std::memory_order_acquire);
+      }
+    }
+#endif
+    if (chunks > 0) {
+      f(0u);
+    }
+  }
+};
+
+// Split [0, count) into at most workers->Threads() chunks of at least
+// minChunk and run f(chunk, begin, end) for each. Chunk 0 runs on the
+// calling thread, the rest on the workers. nullptr runs all on the caller.
+// Returns the number of chunks.
+template <typename F>
+uint32_t ParallelFor(WorkerPool *workers, size_t count, size_t minChunk,
+                     const F &f) {
+  if (count == 0) {
+    return 0;
+  }
+  size_t chunks = std::clamp<size_t>(count / std::max<size_t>(minChunk, 1), 1,
+                                     workers ? workers->Threads() : 1);
+  auto size = (count + chunks - 1) / chunks;
+  // no empty tail
+  chunks = (count + size - 1) / size;
+  auto chunk = [&f, size, count](uint32_t i) {
+    auto begin = i * size;
+    f(i, begin, std::min(begin + size, count));
+  };
+  if (workers) {
+    workers->Run(static_cast<uint32_t>(chunks), chunk);
+  } else {
+    chunk(0u);
+  }
+  return static_cast<uint32_t>(chunks);
+}
+
+} // namespace rectray
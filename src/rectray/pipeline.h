@@ -0,0 +1,102 @@
+#pragma once
+#include "parallel.h"
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+namespace rectray {
+
+//
+// Runs the rectray part of a frame (Gui Begin to Render) on a worker thread
+// while the caller draws the previous frame.
+//
+// * latency 0 runs the work on the caller in Submit(). nothing is deferred
+// * latency 1 hands the work to the worker and returns at once. the caller
+//   draws the markers of frame N - 1 while frame N is recorded, so its own
+//   cost is the handoff. the picture is one frame late
+// * the handoff is one atomic state with wait and notify. no lock
+// * with Gui::SetDoubleBuffer(true) the marker::View of frame N - 1 stays
+//   valid while the worker records frame N
+// * Wait() before touching anything the work reads or writes
+//
+// Without threads (wasm without -pthread) the latency is always 0.
+//
+class FramePipeline {
+  enum State : uint32_t {
+    IDLE,
+    PENDING,
+    STOP,
+  };
+  std::atomic<uint32_t> m_state{IDLE};
+  std::function<void()> m_work;
+  uint32_t m_latency = 0;
+#if RECTRAY_THREADS
+  std::thread m_worker;
+
+  void Loop() {
+    while (true) {
+      m_state.wait(IDLE, std::memory_order_acquire);
+      if (m_state.load(std::memory_order_acquire) == STOP) {
+        return;
+      }
+      m_work();
+      m_work = {};
+      m_state.store(IDLE, std::memory_order_release);
+      m_state.notify_all();
+    }
+  }
+#endif
+
+public:
+  explicit FramePipeline(uint32_t latency = 0) { SetLatency(latency); }
+  ~FramePipeline() {
+#if RECTRAY_THREADS
+    if (m_worker.joinable()) {
+      Wait();
+      m_state.store(STOP, std::memory_order_release);
+      m_state.notify_all();
+      m_worker.join();
+    }
+#endif
+  }
+  FramePipeline(const FramePipeline &) = delete;
+  FramePipeline &operator=(const FramePipeline &) = delete;
+
+  uint32_t Latency() const { return m_latency; }
+
+  // 0 or 1 frame. waits for the work in flight
+  void SetLatency(uint32_t latency) {
+    Wait();
+#if RECTRAY_THREADS
+    m_latency = std::min(latency, 1u);
+    if (m_latency && !m_worker.joinable()) {
+      m_worker = std::thread([this]() { Loop(); });
+    }
+#endif
+  }
+
+  // waits for the previous work, then runs or starts this one
+  void Submit(std::function<void()> work) {
+    Wait();
+    if (m_latency == 0) {
+      work();
+      return;
+    }
+    m_work = std::move(work);
+    m_state.store(PENDING, std::memory_order_release);
+    m_state.notify_all();
+  }
+
+  // the last submitted work is done and its writes are visible
+  void Wait() {
+    while (true) {
+      auto state = m_state.load(std::memory_order_acquire);
+      if (state != PENDING) {
+        return;
+      }
+      m_state.wait(state, std::memory_order_acquire);
+    }
+  }
+};
+
+} // namespace rectray
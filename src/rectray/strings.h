@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rectray {
+
+//
+// Character storage for one frame of labels.
+//
+// * Store() copies into fixed chunks, so a returned view stays valid until
+//   Clear() however much more is stored
+// * Clear() keeps the chunks. a frame like the last one does not allocate
+// * a string longer than CHUNK_SIZE gets a chunk of its own
+//
+class StringArena {
+public:
+  static constexpr size_t CHUNK_SIZE = 4096;
+
+private:
+  struct Chunk {
+    std::unique_ptr<char[]> Bytes;
+    size_t Size;
+  };
+  std::vector<Chunk> m_chunks;
+  // chunk being filled and its used bytes
+  size_t m_chunk = 0;
+  size_t m_used = 0;
+
+public:
+  void Clear() {
+    m_chunk = 0;
+    m_used = 0;
+  }
+
+  std::string_view Store(std::string_view text) {
+    if (text.empty()) {
+      // not null. a consumer may take data() as a C string
+      return "";
+    }
+    while (m_chunk < m_chunks.size() &&
+           m_used + text.size() > m_chunks[m_chunk].Size) {
+      // the rest of this chunk stays unused until Clear()
+      ++m_chunk;
+      m_used = 0;
+    }
+    if (m_chunk == m_chunks.size()) {
+      auto size = std::max(text.size(), CHUNK_SIZE);
+      m_chunks.push_back({std::make_unique<char[]>(size), size});
+    }
+    auto p = m_chunks[m_chunk].Bytes.get() + m_used;
+    text.copy(p, text.size());
+    m_used += text.size();
+    return {p, text.size()};
+  }
+
+  // bytes held, used or not
+  size_t Capacity() const {
+    size_t capacity = 0;
+    for (auto &chunk : m_chunks) {
+      capacity += chunk.Size;
+    }
+    return capacity;
+  }
+};
+
+//
+// One copy of each distinct label, kept across frames.
+//
+// * Intern() of a known label is a hash lookup. nothing is copied
+// * a view stays valid until Clear(), or until Evict() drops it. the nodes
+//   do not move on rehash
+// * each label keeps the frame of its last Intern(). Evict() drops only the
+//   labels not used for a number of frames
+// * for labels that repeat, like object names. a label that changes every
+//   frame, like a measurement, belongs in a StringArena
+//
+class StringInterner {
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+  // label to the frame of its last Intern()
+  std::unordered_map<std::string, uint64_t, Hash, std::equal_to<>> m_strings;
+  uint64_t m_frame = 0;
+
+public:
+  void Clear() { m_strings.clear(); }
+  size_t Size() const { return m_strings.size(); }
+
+  void NextFrame() { ++m_frame; }
+
+  // drop the labels not interned in the last frames frames
+  void Evict(uint64_t frames) {
+    for (auto it = m_strings.begin(); it != m_strings.end();) {
+      if (m_frame - it->second > frames) {
+        it = m_strings.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  std::string_view Intern(std::string_view text) {
+    auto found = m_strings.find(text);
+    if (found == m_strings.end()) {
+      found = m_strings.emplace(text, m_frame).first;
+    } else {
+      found->second = m_frame;
+    }
+    return found->first;
+  }
+};
+
+} // namespace rectray
@@ -0,0 +1,318 @@
+#pragma once
+#include "compact.h"
+#include "kernels.h"
+#include "parallel.h"
+#include <span>
+
+namespace rectray {
+
+namespace marker {
+
+struct TessVertex {
+  // viewport coordinate. add View::Offset for the screen
+  DirectX::XMFLOAT2 Pos;
+  uint32_t Color;
+};
+
+//
+// Markers as one triangle list, for a backend without its own 2D drawing.
+//
+// * circles use a unit circle table per segment count, built once
+// * a thick line is a quad. the segments of polylines, outlines and lines
+//   are expanded together by kernel::ExpandLines. the joints are not
+//   mitered
+// * an outlined circle is a ring of inner and outer points
+// * text is not tessellated. TextMarkers keeps the index in the source
+//   markers
+// * Build() counts each marker first, then writes the chunks of markers on
+//   the worker threads at their offsets
+//
+class Tessellator {
+  std::vector<TessVertex> m_vertices;
+  std::vector<uint32_t> m_indices;
+  std::vector<uint32_t> m_textMarkers;
+  UnitCircles m_circles;
+  // first vertex and index of each marker, and the totals at the end
+  std::vector<uint32_t> m_vertexOffsets;
+  std::vector<uint32_t> m_indexOffsets;
+
+  // segments of one thickness waiting for ExpandLines
+  struct SegmentBatch {
+    float Thickness = 0;
+    std::vector<DirectX::XMFLOAT2> P0;
+    std::vector<DirectX::XMFLOAT2> P1;
+    // first vertex and color of the quad
+    std::vector<uint32_t> Vertex;
+    std::vector<uint32_t> Color;
+    std::vector<DirectX::XMFLOAT2> Quads;
+
+    void Flush(TessVertex *vertices) {
+      if (P0.empty()) {
+        return;
+      }
+      Quads.resize(P0.size() * 4);
+      kernel::ExpandLines(P0, P1, Thickness, Quads);
+      for (size_t i = 0; i < P0.size(); ++i) {
+        auto v = vertices + Vertex[i];
+        for (int k = 0; k < 4; ++k) {
+          v[k] = {Quads[i * 4 + k], Color[i]};
+        }
+      }
+      P0.clear();
+      P1.clear();
+      Vertex.clear();
+      Color.clear();
+    }
+  };
+  // one per chunk
+  std::vector<SegmentBatch> m_batches;
+
+  static int CircleSegmentCount(const Circle &shape) {
+    return std::max(CircleSegments(shape.Radius, shape.Segments), 3);
+  }
+
+  // segments of a polyline, as AddLoop of CompactMarkers
+  static size_t LoopSegments(size_t points, bool closed) {
+    if (points < 2) {
+      return 0;
+    }
+    return points - 1 + (closed && points > 2 ? 1 : 0);
+  }
+
+  struct Counter {
+    Tessellator *Self;
+    const Command &Marker;
+    uint32_t Index;
+    uint32_t Vertices = 0;
+    uint32_t Indices = 0;
+
+    void Quads(size_t count) {
+      Vertices += static_cast<uint32_t>(count * 4);
+      Indices += static_cast<uint32_t>(count * 6);
+    }
+    void Fan(size_t points) {
+      if (points >= 3) {
+        Vertices += static_cast<uint32_t>(points);
+        Indices += static_cast<uint32_t>((points - 2) * 3);
+      }
+    }
+
+    void operator()(const Line &) { Quads(1); }
+    void operator()(const Triangle &) {
+      if (Marker.Thickness) {
+        Quads(3);
+      } else {
+        Fan(3);
+      }
+    }
+    void operator()(const Circle &shape) {
+      auto segments = CircleSegmentCount(shape);
+      Self->m_circles.Get(segments);
+      if (Marker.Thickness) {
+        Vertices += segments * 2;
+        Indices += segments * 6;
+      } else {
+        Fan(segments);
+      }
+    }
+    void operator()(const Polyline &shape) {
+      if (Marker.Thickness) {
+        Quads(LoopSegments(shape.Points.size(), shape.Flags & 1));
+      } else {
+        Fan(shape.Points.size());
+      }
+    }
+    void operator()(const Points &shape) { Quads(shape.Centers.size()); }
+    void operator()(const Lines &shape) { Quads(shape.Points.size() / 2); }
+    void operator()(const Text &) { Self->m_textMarkers.push_back(Index); }
+  };
+
+  struct Writer {
+    const Tessellator *Self;
+    SegmentBatch *Batch;
+    TessVertex *Vertices;
+    uint32_t *Indices;
+    const Command *Marker = nullptr;
+    uint32_t Vertex = 0;
+    uint32_t Index = 0;
+
+    void Triangle(uint32_t a, uint32_t b, uint32_t c) {
+      Indices[Index++] = a;
+      Indices[Index++] = b;
+      Indices[Index++] = c;
+    }
+    // 0 1 2, 0 2 3 from base
+    void Quad(uint32_t base) {
+      Triangle(base, base + 1, base + 2);
+      Triangle(base, base + 2, base + 3);
+    }
+    void Segment(const DirectX::XMFLOAT2 &p0, const DirectX::XMFLOAT2 &p1,
+                 float thickness) {
+      if (Batch->Thickness != thickness) {
+        Batch->Flush(Vertices);
+        Batch->Thickness = thickness;
+      }
+      Batch->P0.push_back(p0);
+      Batch->P1.push_back(p1);
+      Batch->Vertex.push_back(Vertex);
+      Batch->Color.push_back(Marker->Color);
+      Quad(Vertex);
+      Vertex += 4;
+    }
+    void Loop(std::span<const DirectX::XMFLOAT2> points, bool closed,
+              float thickness) {
+      for (size_t i = 1; i < points.size(); ++i) {
+        Segment(points[i - 1], points[i], thickness);
+      }
+      if (closed && points.size() > 2) {
+        Segment(points.back(), points.front(), thickness);
+      }
+    }
+    // convex
+    void Fan(std::span<const DirectX::XMFLOAT2> points) {
+      if (points.size() < 3) {
+        return;
+      }
+      auto first = Vertex;
+      for (auto &p : points) {
+        Vertices[Vertex++] = {p, Marker->Color};
+      }
+      for (uint32_t i = 2; i < points.size(); ++i) {
+        Triangle(first, first + i - 1, first + i);
+      }
+    }
+
+    void operator()(const Line &shape) {
+      Segment(shape.P0, shape.P1, Marker->Thickness.value_or(1.0f));
+    }
+    void operator()(const marker::Triangle &shape) {
+      DirectX::XMFLOAT2 points[] = {shape.P0, shape.P1, shape.P2};
+      if (Marker->Thickness) {
+        Loop(points, true, *Marker->Thickness);
+      } else {
+        Fan(points);
+      }
+    }
+    void operator()(const Circle &shape) {
+      auto segments = CircleSegmentCount(shape);
+      auto &unit = Self->m_circles[segments];
+      auto c = shape.Center;
+      auto first = Vertex;
+      if (Marker->Thickness) {
+        // outer and inner point of each segment
+        auto half = *Marker->Thickness * 0.5f;
+        auto outer = shape.Radius + half;
+        auto inner = std::max(shape.Radius - half, 0.0f);
+        for (auto &u : unit) {
+          Vertices[Vertex++] = {{c.x + u.x * outer, c.y + u.y * outer},
+                                Marker->Color};
+          Vertices[Vertex++] = {{c.x + u.x * inner, c.y + u.y * inner},
+                                Marker->Color};
+        }
+        for (uint32_t i = 0; i < unit.size(); ++i) {
+          auto a = first + i * 2;
+          uint32_t b = first + (i + 1) % unit.size() * 2;
+          Triangle(a, b, b + 1);
+          Triangle(a, b + 1, a + 1);
+        }
+      } else {
+        for (auto &u : unit) {
+          Vertices[Vertex++] = {
+              {c.x + u.x * shape.Radius, c.y + u.y * shape.Radius},
+              Marker->Color};
+        }
+        for (uint32_t i = 2; i < unit.size(); ++i) {
+          Triangle(first, first + i - 1, first + i);
+        }
+      }
+    }
+    void operator()(const Polyline &shape) {
+      if (Marker->Thickness) {
+        Loop(shape.Points, shape.Flags & 1, *Marker->Thickness);
+      } else {
+        Fan(shape.Points);
+      }
+    }
+    void operator()(const Points &shape) {
+      auto r = shape.Radius;
+      for (auto &c : shape.Centers) {
+        auto v = Vertices + Vertex;
+        v[0] = {{c.x - r, c.y - r}, Marker->Color};
+        v[1] = {{c.x + r, c.y - r}, Marker->Color};
+        v[2] = {{c.x + r, c.y + r}, Marker->Color};
+        v[3] = {{c.x - r, c.y + r}, Marker->Color};
+        Quad(Vertex);
+        Vertex += 4;
+      }
+    }
+    void operator()(const Lines &shape) {
+      auto thickness = Marker->Thickness.value_or(1.0f);
+      for (size_t i = 1; i < shape.Points.size(); i += 2) {
+        Segment(shape.Points[i - 1], shape.Points[i], thickness);
+      }
+    }
+    void operator()(const Text &) {}
+  };
+
+public:
+  std::span<const TessVertex> Vertices() const { return m_vertices; }
+  // triangle list
+  std::span<const uint32_t> Indices() const { return m_indices; }
+  const std::vector<uint32_t> &TextMarkers() const { return m_textMarkers; }
+  // first vertex of markers[i] and one past the last at [markers.size()].
+  // the indices of a marker refer to its own vertices only
+  std::span<const uint32_t> VertexOffsets() const { return m_vertexOffsets; }
+  std::span<const uint32_t> IndexOffsets() const { return m_indexOffsets; }
+
+  void Clear() {
+    m_vertices.clear();
+    m_indices.clear();
+    m_textMarkers.clear();
+    m_vertexOffsets.clear();
+    m_indexOffsets.clear();
+  }
+
+  // nullptr builds on the caller only
+  void Build(std::span<const Command> markers, WorkerPool *workers = nullptr) {
+    Clear();
+    m_vertexOffsets.resize(markers.size() + 1);
+    m_indexOffsets.resize(markers.size() + 1);
+    uint32_t vertices = 0;
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < markers.size(); ++i) {
+      m_vertexOffsets[i] = vertices;
+      m_indexOffsets[i] = indices;
+      Counter counter{this, markers[i], i};
+      std::visit(counter, markers[i].Shape);
+      vertices += counter.Vertices;
+      indices += counter.Indices;
+    }
+    m_vertexOffsets.back() = vertices;
+    m_indexOffsets.back() = indices;
+    m_vertices.resize(vertices);
+    m_indices.resize(indices);
+
+    auto threads = workers ? workers->Threads() : 1u;
+    if (m_batches.size() < threads) {
+      m_batches.resize(threads);
+    }
+    const size_t MIN_MARKERS = 1024;
+    ParallelFor(workers, markers.size(), MIN_MARKERS,
+                [this, markers](uint32_t chunk, size_t begin, size_t end) {
+                  auto &batch = m_batches[chunk];
+                  Writer writer{this, &batch, m_vertices.data(),
+                                m_indices.data()};
+                  for (auto i = begin; i < end; ++i) {
+                    writer.Marker = &markers[i];
+                    writer.Vertex = m_vertexOffsets[i];
+                    writer.Index = m_indexOffsets[i];
+                    std::visit(writer, markers[i].Shape);
+                  }
+                  batch.Flush(m_vertices.data());
+                });
+  }
+};
+
+} // namespace marker
+
+} // namespace rectray